@@ -16,35 +16,32 @@ Direction get_direction_from_name(std::string name) {
 
 // Actor functions
 
-const float ACTOR_FRAME_DURATION = 0.1f;
 const int SPEED = 1;
 
 Actor::Actor(std::string name, std::string image_path_prefix) {
     this->name = name;
 
-    image_profile_index = render_load_image(image_path_prefix + "_profile.png");
-    image_idle_index = render_load_spritesheet(image_path_prefix + "_idle.png", (vec2) { .x = 32, .y = 32 });
-    image_walk_index = render_load_spritesheet(image_path_prefix + "_walk.png", (vec2) { .x = 32, .y = 32 });
-    image_index = image_idle_index;
-    image_flipped = false;
+    image_profile_index = render_load_image_async(image_path_prefix + "_profile.png");
+    animations = animation_load_set(image_path_prefix);
 
     facing_direction = DIRECTION_DOWN;
     position = (vec2) { .x = 0, .y = 0 };
+    previous_position = position;
     velocity = (vec2) { .x = 0,. y = 0 };
 
     path_index = 0;
     path_wait_timer = 0;
 
-    animation_timer = 0;
-    animation_frame = 0;
+    animation.clip = -1;
+    animation_play(animation, animations.clips[ANIMATION_IDLE][facing_direction]);
 
     in_scene = false;
     target = (vec2) { .x = -1, .y = -1 };
 }
 
 SDL_Rect Actor::get_rect() const {
-    vec2 frame_size = render_get_frame_size(image_index);
-    return (SDL_Rect) { .x = position.x, .y = position.y, .w = frame_size.x, .h = frame_size.y };
+    const SDL_Rect& frame_rect = animation_get_frame_rect(animation);
+    return (SDL_Rect) { .x = position.x, .y = position.y, .w = frame_rect.w, .h = frame_rect.h };
 }
 
 bool Actor::has_target() const {
@@ -88,7 +85,7 @@ void Actor::update(float delta) {
     } else if(velocity.x < 0) {
         facing_direction = DIRECTION_LEFT;
     }
-    update_sprite(delta);
+    update_sprite();
 }
 
 void Actor::set_velocity_towards(vec2 target_position) {
@@ -145,38 +142,20 @@ void Actor::handle_collision(const SDL_Rect& collider) {
     }
 }
 
-void Actor::update_sprite(float delta) {
-    if(velocity.x == 0 && velocity.y == 0) {
-        image_index = image_idle_index;
-        image_flipped = false;
-        animation_timer = ACTOR_FRAME_DURATION;
-        switch(facing_direction) {
-            case DIRECTION_UP:
-                animation_frame = 3;
-                break;
-            case DIRECTION_RIGHT:
-                animation_frame = 0;
-                break;
-            case DIRECTION_DOWN:
-                animation_frame = 1;
-                break;
-            case DIRECTION_LEFT:
-                animation_frame = 2;
-                break;
-        }
-    } else {
-        image_index = image_walk_index;
-        animation_timer -= delta;
-        if(animation_timer <= 0) {
-            animation_timer += ACTOR_FRAME_DURATION;
-            animation_frame = (animation_frame + 1) % 8; // TODO change this to rely on frame data rather than a hard coded frame count
-        }
-        image_flipped = facing_direction == DIRECTION_LEFT;
-    }
+// Picks the clip for what the actor is doing, the clip itself is advanced by the scene along with every other actor's
+void Actor::update_sprite() {
+    AnimationAction action = (velocity.x == 0 && velocity.y == 0) ? ANIMATION_IDLE : ANIMATION_WALK;
+    animation_play(animation, animations.clips[action][facing_direction]);
 }
 
-void Actor::render(const vec2& camera_offset) {
-    vec2 sprite_frame = (vec2) { .x = animation_frame, .y = 0 };
+void Actor::render(const vec2& camera_offset) const {
+    const AnimationClip& clip = animation_clips[animation.clip];
+    const SDL_Rect& frame_rect = animation_frame_rects[clip.first_frame + animation.frame];
+
+    // Draw partway between the last two simulation ticks so motion stays smooth at any display rate
+    vec2 render_position = vec2_lerp(previous_position, position, render_get_interpolation());
 
-    render_image_frame(image_index, sprite_frame, position - camera_offset, image_flipped);
+    // Sort by the actor's feet so that actors lower on the screen are drawn over the ones behind them
+    render_set_sort_key(render_position.y + frame_rect.h);
+    render_image_rect(clip.image, frame_rect, render_position - camera_offset, clip.flipped);
 }
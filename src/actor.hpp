@@ -1,6 +1,8 @@
 #pragma once
 
 #include "vector.hpp"
+#include "render.hpp"
+#include "animation.hpp"
 #include <SDL2/SDL.h>
 #include <string>
 #include <vector>
@@ -8,6 +10,7 @@
 typedef struct DialogLine {
     std::string speaker;
     std::string text;
+    std::vector<std::size_t> row_starts; // Offsets into text where each wrapped row begins, filled in when the line is queued
 } DialogLine;
 
 typedef enum Direction {
@@ -35,19 +38,17 @@ class Actor {
         void set_velocity_towards(vec2 target_position);
         void set_direction_towards(vec2 target_position);
         void handle_collision(const SDL_Rect& collider);
-        void render(const vec2& camera_offset);
+        void render(const vec2& camera_offset) const;
 
         std::string name;
 
-        int image_idle_index;
-        int image_walk_index;
-        int image_profile_index;
-        int image_index;
-        bool image_flipped;
-        int animation_frame;
+        ImageHandle image_profile_index;
+        AnimationSet animations;
+        AnimationState animation;
 
         Direction facing_direction;
         vec2 position;
+        vec2 previous_position; // Position as of the previous simulation tick, for interpolating between ticks
         vec2 velocity;
 
         std::vector<PathNode> path;
@@ -56,9 +57,7 @@ class Actor {
         bool in_scene;
         vec2 target;
     private:
-        void update_sprite(float delta);
-
-        float animation_timer;
+        void update_sprite();
 
         int path_index;
         float path_wait_timer;
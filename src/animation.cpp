@@ -0,0 +1,203 @@
+#include "animation.hpp"
+
+#include "json.hpp"
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+using nlohmann::json;
+
+const char* ANIMATION_ACTION_NAMES[ANIMATION_ACTION_COUNT] = { "idle", "walk" };
+const char* ANIMATION_DIRECTION_NAMES[4] = { "up", "right", "down", "left" };
+const vec2 DEFAULT_FRAME_SIZE = (vec2) { .x = 32, .y = 32 };
+const float DEFAULT_FRAME_DURATION = 0.1f;
+const int DEFAULT_WALK_FRAME_COUNT = 8;
+
+std::vector<AnimationClip> animation_clips;
+std::vector<SDL_Rect> animation_frame_rects;
+std::vector<float> animation_frame_durations;
+std::unordered_map<std::string, AnimationSet> animation_sets;
+std::vector<int> animation_unchecked_clips; // Clips whose sheet was still loading when they were added
+
+int animation_add_clip(ImageHandle image, vec2 frame_size, int row, const std::vector<int>& frames, const std::vector<float>& durations, bool flipped) {
+    AnimationClip clip = (AnimationClip) {
+        .image = image,
+        .first_frame = (int)animation_frame_rects.size(),
+        .frame_count = (int)frames.size(),
+        .flipped = flipped
+    };
+
+    for(std::size_t i = 0; i < frames.size(); i++) {
+        animation_frame_rects.push_back((SDL_Rect) {
+            .x = frames[i] * frame_size.x,
+            .y = row * frame_size.y,
+            .w = frame_size.x,
+            .h = frame_size.y
+        });
+
+        // Advancing loops until the timer is positive again, so a frame that takes no time would never let it finish
+        float duration = i < durations.size() ? durations[i] : DEFAULT_FRAME_DURATION;
+        if(duration <= 0) {
+            std::cout << "Animation frame " << i << " has a duration of " << duration << ", using " << DEFAULT_FRAME_DURATION << " instead" << std::endl;
+            duration = DEFAULT_FRAME_DURATION;
+        }
+        animation_frame_durations.push_back(duration);
+    }
+
+    animation_clips.push_back(clip);
+    animation_unchecked_clips.push_back(animation_clips.size() - 1);
+    return animation_clips.size() - 1;
+}
+
+// Frame rects are drawn without any checks, so once a clip's sheet has loaded make sure none of its frames reach
+// outside it. Otherwise an atlas packed sheet would quietly draw whichever sprite is packed next to it.
+// Out of range frames are pointed at the sheet's first frame instead
+void animation_check_loaded_clips() {
+    for(std::size_t i = 0; i < animation_unchecked_clips.size(); ) {
+        AnimationClip& clip = animation_clips[animation_unchecked_clips[i]];
+        if(render_image_handle_valid(clip.image) && !render_image_is_loaded(clip.image)) {
+            i++;
+            continue;
+        }
+
+        // A sheet that failed to load leaves nothing to draw, so the clip lets go of its handle rather than looking it up every frame
+        Image* image = render_image_handle_valid(clip.image) ? render_get_image(clip.image) : nullptr;
+        if(image == nullptr || image->texture == nullptr) {
+            clip.image = IMAGE_HANDLE_NONE;
+        } else {
+            for(int frame = clip.first_frame; frame < clip.first_frame + clip.frame_count; frame++) {
+                SDL_Rect& frame_rect = animation_frame_rects[frame];
+                if(frame_rect.x < 0 || frame_rect.y < 0 || frame_rect.x + frame_rect.w > image->size.x || frame_rect.y + frame_rect.h > image->size.y) {
+                    std::cout << "Animation frame (" << frame_rect.x << ", " << frame_rect.y << ") out of bounds for image with path " << render_get_path(clip.image) << std::endl;
+                    frame_rect.x = 0;
+                    frame_rect.y = 0;
+                }
+            }
+        }
+
+        animation_unchecked_clips[i] = animation_unchecked_clips.back();
+        animation_unchecked_clips.pop_back();
+    }
+}
+
+// Without a sidecar file the sheets follow the original layout: the idle sheet has one frame per direction
+// (right, down, left, up) and the walk sheet has a single row of walk frames, mirrored when walking left
+void animation_add_default_clips(AnimationSet& set, AnimationAction action, ImageHandle image) {
+    if(action == ANIMATION_IDLE) {
+        static const int IDLE_FRAMES[4] = { 3, 0, 1, 2 };
+        for(int direction = 0; direction < 4; direction++) {
+            set.clips[action][direction] = animation_add_clip(image, DEFAULT_FRAME_SIZE, 0, { IDLE_FRAMES[direction] }, { DEFAULT_FRAME_DURATION }, false);
+        }
+    } else {
+        std::vector<int> frames;
+        for(int i = 0; i < DEFAULT_WALK_FRAME_COUNT; i++) {
+            frames.push_back(i);
+        }
+        for(int direction = 0; direction < 4; direction++) {
+            set.clips[action][direction] = animation_add_clip(image, DEFAULT_FRAME_SIZE, 0, frames, { }, direction == 3);
+        }
+    }
+}
+
+// A clip as read from a sidecar, before anything is added to the clip tables
+typedef struct SidecarClip {
+    int row;
+    std::vector<int> frames;
+    std::vector<float> durations;
+    bool flipped;
+} SidecarClip;
+
+// The whole sidecar is read and checked before its sheet is loaded or any clips are added, so a bad sidecar
+// leaves nothing behind and the caller can fall back to the default layout
+bool animation_load_sidecar(AnimationSet& set, AnimationAction action, std::string sheet_path, std::string sidecar_path) {
+    std::ifstream sidecar_file;
+    sidecar_file.open(sidecar_path);
+    if(!sidecar_file.is_open()) {
+        return false;
+    }
+    json sidecar_json = json::parse(sidecar_file);
+    sidecar_file.close();
+
+    vec2 frame_size = DEFAULT_FRAME_SIZE;
+    if(sidecar_json.contains("frame_size")) {
+        frame_size = (vec2) {
+            .x = sidecar_json["frame_size"][0].get<int>(),
+            .y = sidecar_json["frame_size"][1].get<int>()
+        };
+    }
+    if(frame_size.x <= 0 || frame_size.y <= 0) {
+        std::cout << "Animation " << sidecar_path << " has a frame size of " << frame_size.x << "x" << frame_size.y << "!" << std::endl;
+        return false;
+    }
+
+    SidecarClip clips[4];
+    for(int direction = 0; direction < 4; direction++) {
+        json clip_json = sidecar_json["directions"][ANIMATION_DIRECTION_NAMES[direction]];
+        if(clip_json.is_null()) {
+            std::cout << "Animation " << sidecar_path << " has no clip for direction " << ANIMATION_DIRECTION_NAMES[direction] << "!" << std::endl;
+            return false;
+        }
+
+        SidecarClip& clip = clips[direction];
+        clip.row = clip_json.value("row", 0);
+        clip.flipped = clip_json.value("flipped", false);
+        if(clip_json.contains("frames")) {
+            clip.frames = clip_json["frames"].get<std::vector<int>>();
+        } else {
+            int first_frame = clip_json.value("first_frame", 0);
+            int frame_count = clip_json.value("frame_count", 1);
+            for(int i = 0; i < frame_count; i++) {
+                clip.frames.push_back(first_frame + i);
+            }
+        }
+        if(clip.frames.empty()) {
+            std::cout << "Animation " << sidecar_path << " has no frames for direction " << ANIMATION_DIRECTION_NAMES[direction] << "!" << std::endl;
+            return false;
+        }
+
+        if(clip_json.contains("durations")) {
+            clip.durations = clip_json["durations"].get<std::vector<float>>();
+        } else {
+            clip.durations.assign(clip.frames.size(), clip_json.value("duration", sidecar_json.value("duration", DEFAULT_FRAME_DURATION)));
+        }
+    }
+
+    ImageHandle image = render_load_spritesheet_async(sheet_path, frame_size);
+    for(int direction = 0; direction < 4; direction++) {
+        const SidecarClip& clip = clips[direction];
+        set.clips[action][direction] = animation_add_clip(image, frame_size, clip.row, clip.frames, clip.durations, clip.flipped);
+    }
+
+    return true;
+}
+
+// Loads the idle and walk sheets for an actor image prefix along with their clips. Sheets can describe their clips
+// in a sidecar json next to them (e.g. res/dogtective_walk.json), otherwise the default layout is assumed
+AnimationSet animation_load_set(std::string image_path_prefix) {
+    auto loaded_set = animation_sets.find(image_path_prefix);
+    if(loaded_set != animation_sets.end()) {
+        return loaded_set->second;
+    }
+
+    AnimationSet set;
+    for(int action = 0; action < ANIMATION_ACTION_COUNT; action++) {
+        std::string sheet_name = image_path_prefix + "_" + ANIMATION_ACTION_NAMES[action];
+        if(!animation_load_sidecar(set, (AnimationAction)action, sheet_name + ".png", sheet_name + ".json")) {
+            ImageHandle image = render_load_spritesheet_async(sheet_name + ".png", DEFAULT_FRAME_SIZE);
+            animation_add_default_clips(set, (AnimationAction)action, image);
+        }
+    }
+
+    animation_sets[image_path_prefix] = set;
+    return set;
+}
+
+void animation_play(AnimationState& state, int clip) {
+    if(state.clip == clip) {
+        return;
+    }
+
+    state.clip = clip;
+    state.frame = 0;
+    state.timer = animation_frame_durations[animation_clips[clip].first_frame];
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "render.hpp"
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+// Animation clips are compiled at load into flat tables. Each clip is a run of precomputed source rects and
+// frame durations, so advancing and drawing an animation is just indexing, with no per-draw arithmetic or checks
+typedef struct AnimationClip {
+    ImageHandle image;
+    int first_frame;
+    int frame_count;
+    bool flipped;
+} AnimationClip;
+
+typedef struct AnimationState {
+    int clip;
+    int frame;
+    float timer;
+} AnimationState;
+
+typedef enum AnimationAction {
+    ANIMATION_IDLE,
+    ANIMATION_WALK,
+    ANIMATION_ACTION_COUNT
+} AnimationAction;
+
+// The clip for every action in every direction, indexed by [AnimationAction][Direction]
+typedef struct AnimationSet {
+    int clips[ANIMATION_ACTION_COUNT][4];
+} AnimationSet;
+
+extern std::vector<AnimationClip> animation_clips;
+extern std::vector<SDL_Rect> animation_frame_rects;
+extern std::vector<float> animation_frame_durations;
+
+AnimationSet animation_load_set(std::string image_path_prefix);
+void animation_play(AnimationState& state, int clip);
+void animation_check_loaded_clips();
+
+inline const SDL_Rect& animation_get_frame_rect(const AnimationState& state) {
+    return animation_frame_rects[animation_clips[state.clip].first_frame + state.frame];
+}
+
+inline void animation_advance(AnimationState& state, float delta) {
+    const AnimationClip& clip = animation_clips[state.clip];
+    if(clip.frame_count <= 1) {
+        return;
+    }
+
+    state.timer -= delta;
+    while(state.timer <= 0) {
+        state.frame = (state.frame + 1) % clip.frame_count;
+        state.timer += animation_frame_durations[clip.first_frame + state.frame];
+    }
+}
@@ -0,0 +1,272 @@
+#include "background.hpp"
+
+#include "json.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+using nlohmann::json;
+
+// Chunks this close to the view are requested ahead of time, and chunks are only evicted once they're
+// further away than the eviction margin so that a camera sitting on a chunk edge doesn't thrash
+const int CHUNK_PREFETCH_MARGIN = 64;
+const int CHUNK_EVICT_MARGIN = 192;
+
+Background::Background() {
+    size = (vec2) { .x = 0, .y = 0 };
+    chunked = false;
+    image = IMAGE_HANDLE_NONE;
+    chunk_size = 0;
+    columns = 0;
+    rows = 0;
+}
+
+bool Background::load(std::string path) {
+    bool is_chunk_manifest = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if(!is_chunk_manifest) {
+        chunked = false;
+        image = render_load_image_async(path);
+        return image != IMAGE_HANDLE_NONE;
+    }
+
+    std::ifstream manifest_file;
+    manifest_file.open(path);
+    if(!manifest_file.is_open()) {
+        std::cout << "Unable to open background chunk manifest " << path << "!" << std::endl;
+        return false;
+    }
+    json manifest_json = json::parse(manifest_file);
+    manifest_file.close();
+
+    chunked = true;
+    std::size_t last_slash = path.find_last_of('/');
+    chunk_directory = last_slash == std::string::npos ? "." : path.substr(0, last_slash);
+    chunk_size = manifest_json["chunk_size"].get<int>();
+    columns = manifest_json["columns"].get<int>();
+    rows = manifest_json["rows"].get<int>();
+    size = (vec2) {
+        .x = manifest_json["map_size"][0].get<int>(),
+        .y = manifest_json["map_size"][1].get<int>()
+    };
+    chunks.assign(columns * rows, IMAGE_HANDLE_NONE);
+
+    return true;
+}
+
+void Background::unload() {
+    if(!chunked) {
+        render_unload_image(image);
+        image = IMAGE_HANDLE_NONE;
+        return;
+    }
+
+    for(int chunk_index : resident_chunks) {
+        render_unload_image(chunks[chunk_index]);
+        chunks[chunk_index] = IMAGE_HANDLE_NONE;
+    }
+    resident_chunks.clear();
+}
+
+std::string Background::get_chunk_path(int column, int row) const {
+    return chunk_directory + "/" + std::to_string(column) + "_" + std::to_string(row) + ".png";
+}
+
+void Background::update(const vec2& camera_offset) {
+    if(!chunked) {
+        return;
+    }
+
+    // Evict resident chunks that have drifted out past the eviction margin
+    SDL_Rect evict_rect = (SDL_Rect) {
+        .x = camera_offset.x - CHUNK_EVICT_MARGIN,
+        .y = camera_offset.y - CHUNK_EVICT_MARGIN,
+        .w = SCREEN_WIDTH + (CHUNK_EVICT_MARGIN * 2),
+        .h = SCREEN_HEIGHT + (CHUNK_EVICT_MARGIN * 2)
+    };
+    for(std::size_t i = 0; i < resident_chunks.size(); ) {
+        int chunk_index = resident_chunks[i];
+        SDL_Rect chunk_rect = (SDL_Rect) {
+            .x = (chunk_index % columns) * chunk_size,
+            .y = (chunk_index / columns) * chunk_size,
+            .w = chunk_size,
+            .h = chunk_size
+        };
+        if(rects_intersect(chunk_rect, evict_rect)) {
+            i++;
+            continue;
+        }
+
+        render_unload_image(chunks[chunk_index]);
+        chunks[chunk_index] = IMAGE_HANDLE_NONE;
+        resident_chunks[i] = resident_chunks.back();
+        resident_chunks.pop_back();
+    }
+
+    // Request any chunks within the prefetch margin that aren't loaded yet
+    int first_column = std::max((camera_offset.x - CHUNK_PREFETCH_MARGIN) / chunk_size, 0);
+    int first_row = std::max((camera_offset.y - CHUNK_PREFETCH_MARGIN) / chunk_size, 0);
+    int last_column = std::min((camera_offset.x + SCREEN_WIDTH + CHUNK_PREFETCH_MARGIN) / chunk_size, columns - 1);
+    int last_row = std::min((camera_offset.y + SCREEN_HEIGHT + CHUNK_PREFETCH_MARGIN) / chunk_size, rows - 1);
+    for(int row = first_row; row <= last_row; row++) {
+        for(int column = first_column; column <= last_column; column++) {
+            int chunk_index = (row * columns) + column;
+            if(chunks[chunk_index] == IMAGE_HANDLE_NONE) {
+                chunks[chunk_index] = render_load_image_async(get_chunk_path(column, row));
+                resident_chunks.push_back(chunk_index);
+            }
+        }
+    }
+}
+
+void Background::render(const vec2& camera_offset) {
+    if(!chunked) {
+        render_image(image, camera_offset.inverse());
+        return;
+    }
+
+    // Only visit the chunks that overlap the view rather than the whole grid
+    int first_column = std::max(camera_offset.x / chunk_size, 0);
+    int first_row = std::max(camera_offset.y / chunk_size, 0);
+    int last_column = std::min((camera_offset.x + SCREEN_WIDTH - 1) / chunk_size, columns - 1);
+    int last_row = std::min((camera_offset.y + SCREEN_HEIGHT - 1) / chunk_size, rows - 1);
+
+    for(int row = first_row; row <= last_row; row++) {
+        for(int column = first_column; column <= last_column; column++) {
+            ImageHandle chunk = chunks[(row * columns) + column];
+            if(chunk == IMAGE_HANDLE_NONE || !render_image_is_loaded(chunk)) {
+                continue;
+            }
+
+            vec2 chunk_position = (vec2) { .x = column * chunk_size, .y = row * chunk_size };
+            render_image(chunk, chunk_position - camera_offset);
+        }
+    }
+}
+
+// Background layers
+
+// Composites cover this much more than the view in each axis, so the camera can move this far before one is redrawn
+const int LAYER_COMPOSITE_MARGIN = 128;
+
+BackgroundLayers::BackgroundLayers() {
+}
+
+void BackgroundLayers::add_layer(std::string path, vec2 position, float scroll_x, float scroll_y, BackgroundPlane plane) {
+    ImageHandle layer_image = render_load_image_async(path);
+    if(layer_image == IMAGE_HANDLE_NONE) {
+        return;
+    }
+
+    if(groups.empty() || groups.back().plane != plane || groups.back().scroll_x != scroll_x || groups.back().scroll_y != scroll_y) {
+        groups.push_back((LayerGroup) {
+            .plane = plane,
+            .scroll_x = scroll_x,
+            .scroll_y = scroll_y,
+            .layers = std::vector<Layer>(),
+            .composite = IMAGE_HANDLE_NONE,
+            .composite_origin = (vec2) { .x = 0, .y = 0 },
+            .composed = false,
+            .compositable = true
+        });
+    }
+    groups.back().layers.push_back((Layer) { .image = layer_image, .position = position });
+}
+
+void BackgroundLayers::unload() {
+    for(LayerGroup& group : groups) {
+        for(Layer& layer : group.layers) {
+            render_unload_image(layer.image);
+        }
+        render_unload_image(group.composite);
+    }
+    groups.clear();
+}
+
+vec2 BackgroundLayers::get_view_offset(const LayerGroup& group, const vec2& camera_offset) const {
+    return (vec2) {
+        .x = (int)std::floor(camera_offset.x * group.scroll_x),
+        .y = (int)std::floor(camera_offset.y * group.scroll_y)
+    };
+}
+
+// Redraws any composites the view has moved out of. This switches render targets, so call it before anything is queued for the screen
+void BackgroundLayers::compose(const vec2& camera_offset) {
+    for(LayerGroup& group : groups) {
+        // A lone layer is already a single texture, so there's nothing to gain from compositing it
+        if(group.layers.size() < 2 || !group.compositable) {
+            continue;
+        }
+
+        vec2 view_offset = get_view_offset(group, camera_offset);
+        vec2 origin = (vec2) {
+            .x = (int)std::floor((float)view_offset.x / LAYER_COMPOSITE_MARGIN) * LAYER_COMPOSITE_MARGIN,
+            .y = (int)std::floor((float)view_offset.y / LAYER_COMPOSITE_MARGIN) * LAYER_COMPOSITE_MARGIN
+        };
+        if(group.composed && origin == group.composite_origin) {
+            continue;
+        }
+
+        // Wait for every layer so the composite isn't missing pieces, drawing them individually in the meantime
+        bool layers_loaded = true;
+        for(const Layer& layer : group.layers) {
+            layers_loaded = layers_loaded && render_image_is_loaded(layer.image);
+        }
+        if(!layers_loaded) {
+            group.composed = false;
+            continue;
+        }
+
+        if(group.composite == IMAGE_HANDLE_NONE) {
+            group.composite = render_create_target((vec2) {
+                .x = SCREEN_WIDTH + LAYER_COMPOSITE_MARGIN,
+                .y = SCREEN_HEIGHT + LAYER_COMPOSITE_MARGIN
+            });
+            if(group.composite == IMAGE_HANDLE_NONE) {
+                continue;
+            }
+            // Without premultiplied blending the composite's soft edges would come out darker, so draw the layers one by one instead
+            if(!render_set_target_premultiplied(group.composite)) {
+                render_unload_image(group.composite);
+                group.composite = IMAGE_HANDLE_NONE;
+                group.compositable = false;
+                continue;
+            }
+        }
+
+        render_begin_target(group.composite);
+        render_clear_target((SDL_Color) { .r = 0, .g = 0, .b = 0, .a = 0 });
+        render_set_layer(RENDER_LAYER_BACKGROUND);
+        for(const Layer& layer : group.layers) {
+            render_image(layer.image, layer.position - origin);
+        }
+        render_end_target();
+
+        group.composite_origin = origin;
+        group.composed = true;
+    }
+}
+
+// The composites are render targets, so they need drawing again after the renderer resets them
+void BackgroundLayers::invalidate() {
+    for(LayerGroup& group : groups) {
+        group.composed = false;
+    }
+}
+
+void BackgroundLayers::render(BackgroundPlane plane, const vec2& camera_offset) {
+    for(const LayerGroup& group : groups) {
+        if(group.plane != plane) {
+            continue;
+        }
+
+        vec2 view_offset = get_view_offset(group, camera_offset);
+        if(group.composed) {
+            render_image(group.composite, group.composite_origin - view_offset);
+            continue;
+        }
+        for(const Layer& layer : group.layers) {
+            render_image(layer.image, layer.position - view_offset);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "render.hpp"
+#include "vector.hpp"
+#include <string>
+#include <vector>
+
+// A scene's map background. It's either a single image, or a grid of chunk images produced by the map_chunker tool,
+// in which case only the chunks around the camera are kept loaded and the rest are streamed in and out as it moves
+class Background {
+    public:
+        Background();
+        bool load(std::string path);
+        void unload();
+        void update(const vec2& camera_offset);
+        void render(const vec2& camera_offset);
+
+        vec2 size;
+    private:
+        std::string get_chunk_path(int column, int row) const;
+
+        bool chunked;
+        ImageHandle image;
+
+        std::string chunk_directory;
+        int chunk_size;
+        int columns;
+        int rows;
+        std::vector<ImageHandle> chunks;
+        std::vector<int> resident_chunks;
+};
+
+typedef enum BackgroundPlane {
+    BACKGROUND_PLANE_BACK,  // over the map background, behind the actors
+    BACKGROUND_PLANE_FRONT  // in front of the actors
+} BackgroundPlane;
+
+// Decorative image layers that each scroll at their own rate relative to the camera. Consecutive layers in the same
+// plane that scroll together are flattened into one cached composite target, which covers the view plus a margin and
+// is only redrawn when the camera crosses into a different margin-sized cell
+class BackgroundLayers {
+    public:
+        BackgroundLayers();
+        void add_layer(std::string path, vec2 position, float scroll_x, float scroll_y, BackgroundPlane plane);
+        void unload();
+        void compose(const vec2& camera_offset);
+        void render(BackgroundPlane plane, const vec2& camera_offset);
+        void invalidate();
+    private:
+        typedef struct Layer {
+            ImageHandle image;
+            vec2 position;
+        } Layer;
+
+        typedef struct LayerGroup {
+            BackgroundPlane plane;
+            float scroll_x;
+            float scroll_y;
+            std::vector<Layer> layers;
+            ImageHandle composite;
+            vec2 composite_origin;
+            bool composed;
+            bool compositable; // False when the renderer can't draw the composite with premultiplied alpha
+        } LayerGroup;
+
+        vec2 get_view_offset(const LayerGroup& group, const vec2& camera_offset) const;
+
+        std::vector<LayerGroup> groups;
+};
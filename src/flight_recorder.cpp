@@ -0,0 +1,138 @@
+#include "flight_recorder.hpp"
+
+#include "frame_stats.hpp"
+#include "pacer.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using nlohmann::json;
+
+typedef struct FlightEvent {
+    unsigned long frame;
+    double time_ms;
+    const char* name;
+    char detail[64];
+} FlightEvent;
+
+const int FLIGHT_RECORDER_EVENT_CAPACITY = 256;
+const int FLIGHT_RECORDER_DUMP_FRAMES = 180;
+// After a dump, further spikes are ignored for this many frames so that a slow stretch, or the dump itself, doesn't flood the disk
+const int FLIGHT_RECORDER_COOLDOWN_FRAMES = 300;
+// Unless a budget is set, frames get the pacer's frame duration plus this much, or the uncapped budget when nothing paces them
+const double FLIGHT_RECORDER_BUDGET_MARGIN_MS = 8.0;
+const double FLIGHT_RECORDER_UNCAPPED_BUDGET_MS = 25.0;
+
+FlightEvent flight_events[FLIGHT_RECORDER_EVENT_CAPACITY];
+int flight_event_count = 0;
+int flight_event_newest = -1;
+double flight_recorder_budget_ms = 0.0; // 0 follows the pacer
+std::string flight_recorder_directory = ".";
+int flight_recorder_cooldown = 0;
+
+void flight_recorder_set_budget(double budget_ms) {
+    flight_recorder_budget_ms = budget_ms;
+}
+
+double flight_recorder_get_budget() {
+    if(flight_recorder_budget_ms > 0.0) {
+        return flight_recorder_budget_ms;
+    }
+
+    double frame_duration_ms = pacer_get_frame_duration() * 1000.0;
+    return frame_duration_ms > 0.0 ? frame_duration_ms + FLIGHT_RECORDER_BUDGET_MARGIN_MS : FLIGHT_RECORDER_UNCAPPED_BUDGET_MS;
+}
+
+// Every phase except the total, which also covers the pacer's wait between frames
+double flight_recorder_get_work_ms(const FrameTiming& timing) {
+    double work_ms = 0.0;
+    for(int phase = 0; phase < FRAME_PHASE_TOTAL; phase++) {
+        work_ms += timing.phase_ms[phase];
+    }
+
+    return work_ms;
+}
+
+void flight_recorder_set_directory(std::string directory) {
+    flight_recorder_directory = directory;
+}
+
+// The detail is copied, truncated if need be, so it can come from a temporary. The name must be a string literal
+void flight_recorder_event(const char* name, const char* detail) {
+    flight_event_newest = (flight_event_newest + 1) % FLIGHT_RECORDER_EVENT_CAPACITY;
+    flight_event_count = std::min(flight_event_count + 1, FLIGHT_RECORDER_EVENT_CAPACITY);
+
+    FlightEvent& event = flight_events[flight_event_newest];
+    event.frame = frame_stats_get_frame(0).frame;
+    event.time_ms = pacer_now() * 1000.0;
+    event.name = name;
+    strncpy(event.detail, detail == nullptr ? "" : detail, sizeof(event.detail) - 1);
+    event.detail[sizeof(event.detail) - 1] = '\0';
+}
+
+// Call once a frame, after frame_stats_begin_frame, to check whether the frame that just finished went over budget.
+// Returns whether a recording was written
+bool flight_recorder_check_frame() {
+    if(flight_recorder_cooldown > 0) {
+        flight_recorder_cooldown--;
+        return false;
+    }
+    if(frame_stats_get_frame_count() < 2) {
+        return false;
+    }
+
+    const FrameTiming& last_frame = frame_stats_get_frame(1);
+    if(flight_recorder_get_work_ms(last_frame) <= flight_recorder_get_budget()) {
+        return false;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/flight_%06lu.json", flight_recorder_directory.c_str(), last_frame.frame);
+    flight_recorder_cooldown = FLIGHT_RECORDER_COOLDOWN_FRAMES;
+    return flight_recorder_dump(path);
+}
+
+bool flight_recorder_dump(std::string path) {
+    std::ofstream file;
+    file.open(path);
+    if(!file.is_open()) {
+        std::cout << "Unable to open flight recorder file " << path << "!" << std::endl;
+        return false;
+    }
+
+    json recording_json;
+    recording_json["budget_ms"] = flight_recorder_get_budget();
+    recording_json["spike_frame"] = frame_stats_get_frame(1).frame;
+    recording_json["spike_work_ms"] = flight_recorder_get_work_ms(frame_stats_get_frame(1));
+
+    int frame_count = std::min(FLIGHT_RECORDER_DUMP_FRAMES, frame_stats_get_frame_count() - 1);
+    recording_json["frames"] = json::array();
+    for(int frames_ago = frame_count; frames_ago >= 1; frames_ago--) {
+        const FrameTiming& timing = frame_stats_get_frame(frames_ago);
+        json frame_json;
+        frame_json["frame"] = timing.frame;
+        for(int phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+            frame_json[std::string(FRAME_PHASE_NAMES[phase]) + "_ms"] = timing.phase_ms[phase];
+        }
+        recording_json["frames"].push_back(frame_json);
+    }
+
+    recording_json["events"] = json::array();
+    for(int i = flight_event_count - 1; i >= 0; i--) {
+        const FlightEvent& event = flight_events[(flight_event_newest - i + FLIGHT_RECORDER_EVENT_CAPACITY) % FLIGHT_RECORDER_EVENT_CAPACITY];
+        recording_json["events"].push_back({
+            { "frame", event.frame },
+            { "time_ms", event.time_ms },
+            { "name", event.name },
+            { "detail", event.detail }
+        });
+    }
+
+    file << recording_json.dump(4) << std::endl;
+    file.close();
+    std::cout << "Frame " << frame_stats_get_frame(1).frame << " went over its " << flight_recorder_get_budget() << "ms budget, wrote flight recording to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+// Always-on recorder of what the last few seconds looked like. It keeps a small ring of notable events, and whenever
+// a frame goes over budget it writes those events along with the recent frame timings from frame_stats to disk, so
+// hitches that only happen on someone else's machine leave evidence behind. Events must be recorded on the main thread.
+// Only the frame's work is held against the budget, the time the pacer spends waiting for the next frame isn't
+void flight_recorder_set_budget(double budget_ms);
+double flight_recorder_get_budget();
+void flight_recorder_set_directory(std::string directory);
+void flight_recorder_event(const char* name, const char* detail);
+bool flight_recorder_check_frame();
+bool flight_recorder_dump(std::string path);
@@ -0,0 +1,143 @@
+#include "frame_stats.hpp"
+
+#include "pacer.hpp"
+#include "json.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using nlohmann::json;
+
+const char* FRAME_PHASE_NAMES[FRAME_PHASE_COUNT] = { "input", "update", "player", "scripts", "actors", "collision", "camera", "render", "present", "total" };
+
+FrameTiming frame_timings[FRAME_STATS_HISTORY];
+int frame_timing_count = 0;
+int frame_timing_newest = -1;
+unsigned long frame_stats_frame = 0;
+double frame_start_time = 0.0;
+int frame_phase = -1;
+double frame_phase_start_time = 0.0;
+double frame_stats_sort_buffer[FRAME_STATS_HISTORY];
+
+// Closes out the previous frame's total and starts a fresh entry in the ring buffer
+void frame_stats_begin_frame() {
+    double now = pacer_now();
+    frame_stats_end_phase();
+    if(frame_timing_newest != -1) {
+        frame_timings[frame_timing_newest].phase_ms[FRAME_PHASE_TOTAL] = (now - frame_start_time) * 1000.0;
+    }
+
+    frame_timing_newest = (frame_timing_newest + 1) % FRAME_STATS_HISTORY;
+    frame_timing_count = std::min(frame_timing_count + 1, FRAME_STATS_HISTORY);
+    FrameTiming& timing = frame_timings[frame_timing_newest];
+    timing.frame = frame_stats_frame;
+    for(int i = 0; i < FRAME_PHASE_COUNT; i++) {
+        timing.phase_ms[i] = 0.0;
+    }
+
+    frame_stats_frame++;
+    frame_start_time = now;
+}
+
+void frame_stats_begin_phase(FramePhase phase) {
+    frame_stats_end_phase();
+    frame_phase = phase;
+    frame_phase_start_time = pacer_now();
+}
+
+// Phases can be entered more than once a frame, so their times add up rather than overwrite
+void frame_stats_end_phase() {
+    if(frame_phase == -1 || frame_timing_newest == -1) {
+        frame_phase = -1;
+        return;
+    }
+    frame_timings[frame_timing_newest].phase_ms[frame_phase] += (pacer_now() - frame_phase_start_time) * 1000.0;
+    frame_phase = -1;
+}
+
+int frame_stats_get_frame_count() {
+    return frame_timing_count;
+}
+
+// 0 is the frame currently being timed, 1 is the last complete frame and so on
+const FrameTiming& frame_stats_get_frame(int frames_ago) {
+    int index = (frame_timing_newest - frames_ago + FRAME_STATS_HISTORY) % FRAME_STATS_HISTORY;
+    return frame_timings[index];
+}
+
+// Nearest rank percentiles over the last window complete frames
+FrameTimeSummary frame_stats_summarize(FramePhase phase, int window) {
+    FrameTimeSummary summary = (FrameTimeSummary) { .p50 = 0.0, .p95 = 0.0, .p99 = 0.0, .max = 0.0, .samples = 0 };
+    int sample_count = std::min(window, frame_timing_count - 1);
+    if(sample_count <= 0) {
+        return summary;
+    }
+
+    for(int i = 0; i < sample_count; i++) {
+        frame_stats_sort_buffer[i] = frame_stats_get_frame(i + 1).phase_ms[phase];
+    }
+    std::sort(frame_stats_sort_buffer, frame_stats_sort_buffer + sample_count);
+
+    auto percentile = [sample_count](double p) {
+        int rank = (int)(p * sample_count + 0.999999);
+        return frame_stats_sort_buffer[std::clamp(rank - 1, 0, sample_count - 1)];
+    };
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.max = frame_stats_sort_buffer[sample_count - 1];
+    summary.samples = sample_count;
+    return summary;
+}
+
+// Every complete frame in the history, oldest first
+bool frame_stats_write_csv(std::string path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if(file == nullptr) {
+        std::cout << "Unable to open frame stats file " << path << "!" << std::endl;
+        return false;
+    }
+
+    fprintf(file, "frame");
+    for(int phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+        fprintf(file, ",%s_ms", FRAME_PHASE_NAMES[phase]);
+    }
+    fprintf(file, "\n");
+    for(int frames_ago = frame_timing_count - 1; frames_ago >= 1; frames_ago--) {
+        const FrameTiming& timing = frame_stats_get_frame(frames_ago);
+        fprintf(file, "%lu", timing.frame);
+        for(int phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+            fprintf(file, ",%.4f", timing.phase_ms[phase]);
+        }
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Percentile summaries of every phase over the last window frames
+bool frame_stats_write_json(std::string path, int window) {
+    std::ofstream file;
+    file.open(path);
+    if(!file.is_open()) {
+        std::cout << "Unable to open frame stats file " << path << "!" << std::endl;
+        return false;
+    }
+
+    json stats_json;
+    for(int phase = 0; phase < FRAME_PHASE_COUNT; phase++) {
+        FrameTimeSummary summary = frame_stats_summarize((FramePhase)phase, window);
+        stats_json["samples"] = summary.samples;
+        stats_json["phases"][FRAME_PHASE_NAMES[phase]] = {
+            { "p50_ms", summary.p50 },
+            { "p95_ms", summary.p95 },
+            { "p99_ms", summary.p99 },
+            { "max_ms", summary.max }
+        };
+    }
+    file << stats_json.dump(4) << std::endl;
+    file.close();
+    return true;
+}
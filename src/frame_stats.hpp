@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+
+// States break their update down into the finer phases, so update only counts what's left over
+typedef enum FramePhase {
+    FRAME_PHASE_INPUT,
+    FRAME_PHASE_UPDATE,
+    FRAME_PHASE_PLAYER,
+    FRAME_PHASE_SCRIPTS,
+    FRAME_PHASE_ACTORS,
+    FRAME_PHASE_COLLISION,
+    FRAME_PHASE_CAMERA,
+    FRAME_PHASE_RENDER,
+    FRAME_PHASE_PRESENT,
+    FRAME_PHASE_TOTAL, // The whole frame including pacing, recorded automatically rather than begun like the others
+    FRAME_PHASE_COUNT
+} FramePhase;
+
+extern const char* FRAME_PHASE_NAMES[FRAME_PHASE_COUNT];
+
+typedef struct FrameTiming {
+    unsigned long frame;
+    double phase_ms[FRAME_PHASE_COUNT];
+} FrameTiming;
+
+typedef struct FrameTimeSummary {
+    double p50;
+    double p95;
+    double p99;
+    double max;
+    int samples;
+} FrameTimeSummary;
+
+// How many frames of timings are kept, and how many of the most recent ones summaries cover by default
+const int FRAME_STATS_HISTORY = 1024;
+const int FRAME_STATS_WINDOW = 300;
+
+// Per-frame timings of each phase of the main loop, kept in a ring buffer so that tail latency can be
+// compared between builds and scenes. Starting a phase ends whichever one was running
+void frame_stats_begin_frame();
+void frame_stats_begin_phase(FramePhase phase);
+void frame_stats_end_phase();
+int frame_stats_get_frame_count();
+const FrameTiming& frame_stats_get_frame(int frames_ago);
+FrameTimeSummary frame_stats_summarize(FramePhase phase, int window);
+bool frame_stats_write_csv(std::string path);
+bool frame_stats_write_json(std::string path, int window);
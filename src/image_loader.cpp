@@ -0,0 +1,128 @@
+#include "image_loader.hpp"
+
+#include "trace.hpp"
+
+#include <SDL2/SDL_image.h>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct ImageLoadRequest {
+    int request_id;
+    std::string path;
+} ImageLoadRequest;
+
+std::vector<std::thread> image_loader_workers;
+std::mutex image_loader_mutex;
+std::condition_variable image_loader_request_ready;
+std::condition_variable image_loader_result_ready;
+std::deque<ImageLoadRequest> image_loader_requests;
+std::deque<ImageLoadResult> image_loader_results;
+int image_loader_in_flight = 0;
+bool image_loader_running = false;
+
+void image_loader_work() {
+    TRACE_THREAD_NAME("image loader");
+    while(true) {
+        ImageLoadRequest request;
+        {
+            std::unique_lock<std::mutex> lock(image_loader_mutex);
+            image_loader_request_ready.wait(lock, [] { return !image_loader_running || !image_loader_requests.empty(); });
+            if(!image_loader_running) {
+                return;
+            }
+            request = image_loader_requests.front();
+            image_loader_requests.pop_front();
+        }
+
+        // Decode and convert to the renderer's usual texture format here so the upload on the main thread is a straight copy
+        TRACE_SCOPE("image_loader_decode");
+        SDL_Surface* surface = IMG_Load(request.path.c_str());
+        if(surface == nullptr) {
+            std::cout << "Unable to load image " << request.path << "! SDL Error " << IMG_GetError() << std::endl;
+        } else {
+            SDL_Surface* converted_surface = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+            if(converted_surface != nullptr) {
+                SDL_FreeSurface(surface);
+                surface = converted_surface;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(image_loader_mutex);
+            image_loader_results.push_back((ImageLoadResult) {
+                .request_id = request.request_id,
+                .path = request.path,
+                .surface = surface
+            });
+        }
+        image_loader_result_ready.notify_one();
+    }
+}
+
+void image_loader_init(int worker_count) {
+    if(worker_count < 1) {
+        worker_count = 1;
+    }
+
+    image_loader_running = true;
+    for(int i = 0; i < worker_count; i++) {
+        image_loader_workers.push_back(std::thread(image_loader_work));
+    }
+}
+
+void image_loader_quit() {
+    {
+        std::lock_guard<std::mutex> lock(image_loader_mutex);
+        image_loader_running = false;
+        image_loader_requests.clear();
+    }
+    image_loader_request_ready.notify_all();
+
+    for(std::thread& worker : image_loader_workers) {
+        worker.join();
+    }
+    image_loader_workers.clear();
+
+    for(ImageLoadResult& result : image_loader_results) {
+        SDL_FreeSurface(result.surface);
+    }
+    image_loader_results.clear();
+    image_loader_in_flight = 0;
+}
+
+void image_loader_request(std::string path, int request_id) {
+    {
+        std::lock_guard<std::mutex> lock(image_loader_mutex);
+        image_loader_requests.push_back((ImageLoadRequest) {
+            .request_id = request_id,
+            .path = path
+        });
+        image_loader_in_flight++;
+    }
+    image_loader_request_ready.notify_one();
+}
+
+// Pops one finished load. If wait is set this blocks until a result is ready, unless nothing is in flight
+bool image_loader_poll(ImageLoadResult& result, bool wait) {
+    std::unique_lock<std::mutex> lock(image_loader_mutex);
+    if(wait) {
+        image_loader_result_ready.wait(lock, [] { return !image_loader_results.empty() || image_loader_in_flight == 0; });
+    }
+    if(image_loader_results.empty()) {
+        return false;
+    }
+
+    result = image_loader_results.front();
+    image_loader_results.pop_front();
+    image_loader_in_flight--;
+    return true;
+}
+
+int image_loader_pending() {
+    std::lock_guard<std::mutex> lock(image_loader_mutex);
+    return image_loader_in_flight;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+
+typedef struct ImageLoadResult {
+    int request_id;
+    std::string path;
+    SDL_Surface* surface; // nullptr if the image couldn't be decoded
+} ImageLoadResult;
+
+// Worker pool that decodes images off the main thread. Workers only produce surfaces,
+// creating textures from them is left to the main thread since the renderer isn't thread safe
+void image_loader_init(int worker_count);
+void image_loader_quit();
+void image_loader_request(std::string path, int request_id);
+bool image_loader_poll(ImageLoadResult& result, bool wait);
+int image_loader_pending();
@@ -1,9 +1,21 @@
 #include "render.hpp"
 #include "state.hpp"
 #include "scene.hpp"
+#include "scratch.hpp"
+#include "pacer.hpp"
+#include "frame_stats.hpp"
+#include "trace.hpp"
+#include "flight_recorder.hpp"
+#include "image_loader.hpp"
+#include "profiler_overlay.hpp"
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -24,11 +36,28 @@ bool engine_is_running = true;
 bool engine_render_fps = false;
 std::string map_path = "./map/test.json";
 
+// Headless variables, used to render into memory on machines without a display or GPU
+bool engine_is_headless = false;
+SDL_Surface* headless_surface = nullptr;
+int headless_frame_limit = -1;
+bool headless_print_checksums = false;
+std::string headless_dump_directory = "";
+int headless_frame = 0;
+
+// Frame scratch memory, for text and buffers that are only needed until the frame is presented
+const std::size_t FRAME_SCRATCH_SIZE = 64 * 1024;
+
 // Timing variables
-const float FRAME_DURATION = 1.0f / 60.0f;
-float last_frame_time = 0.0f;
-float last_update_time = 0.0f;
-float last_second_time = 0.0f;
+const float SIMULATION_TICK = 1.0f / 60.0f;
+const int MAX_SIMULATION_TICKS_PER_FRAME = 5;
+float simulation_accumulator = 0.0f;
+std::string trace_path = "trace.json"; // Written on F4, and on exit if --trace was given
+bool trace_write_on_exit = false;
+std::string frame_stats_path = "frame_stats"; // Written to as .csv and .json on F3, and on exit if --frame-stats was given
+bool frame_stats_write_on_exit = false;
+int target_frame_rate = 60; // 0 runs uncapped
+bool vsync_requested = true;
+double last_second_time = 0.0;
 int frames_this_second = 0;
 int fps = 0;
 float delta = 0.0f;
@@ -38,83 +67,241 @@ float dps = 0;
 IState* state;
 std::vector<IState*> states;
 
+// Overlay states freeze everything beneath them, so the states they render over are drawn once into this snapshot
+ImageHandle state_snapshot = IMAGE_HANDLE_NONE;
+bool state_snapshot_valid = false;
+
 // Game loop functions
 void input();
 void update();
-void render();
+bool render();
 
 // Engine functions
 bool engine_init(int argc, char** argv);
 void engine_quit();
 void engine_set_resolution(int width, int height);
 void engine_toggle_fullscreen();
-void engine_clock_tick();
+void engine_clock_tick(bool frame_presented);
+void engine_capture_headless_frame();
+void engine_write_frame_stats();
 
 int main(int argc, char** argv) {
     if(!engine_init(argc, argv)) {
+        // Joinable workers would abort the program on exit, this does nothing if they were never started
+        image_loader_quit();
         return 0;
     }
 
     states.push_back(new Scene(map_path));
 
     while(engine_is_running && !states.empty()) {
+        scratch_reset();
+        frame_stats_begin_frame();
+        flight_recorder_check_frame();
+        frame_stats_begin_phase(FRAME_PHASE_INPUT);
         input();
+        frame_stats_begin_phase(FRAME_PHASE_UPDATE);
         update();
-        render();
-        engine_clock_tick();
+        frame_stats_begin_phase(FRAME_PHASE_RENDER);
+        bool frame_presented = render();
+        frame_stats_end_phase();
+        if(engine_is_headless) {
+            engine_capture_headless_frame();
+        }
+        engine_clock_tick(frame_presented);
 
         if(states[states.size() - 1]->finished) {
             states.pop_back();
+            flight_recorder_event("state popped", "");
+            state_snapshot_valid = false;
+            render_mark_dirty();
         } else if(states[states.size() - 1]->new_state != nullptr) {
             states.push_back(states[states.size() - 1]->new_state);
             states[states.size() - 2]->new_state = nullptr;
+            flight_recorder_event("state pushed", "");
+            state_snapshot_valid = false;
+            render_mark_dirty();
         }
     }
 
+    if(frame_stats_write_on_exit) {
+        engine_write_frame_stats();
+    }
+    if(trace_write_on_exit) {
+        trace_write(trace_path);
+    }
+    engine_quit();
+
     return 0;
 }
 
 // Game loop functions
 
 void input() {
+    TRACE_SCOPE("input");
     SDL_Event e;
     while(SDL_PollEvent(&e) != 0) {
+        // Input can change anything on screen, and window events may have lost the last frame
+        render_mark_dirty();
+
         if(e.type == SDL_QUIT) {
             engine_is_running = false;
+        } else if(e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET) {
+            // The renderer threw away what was drawn into the target textures, so everything cached in one has to be redrawn
+            flight_recorder_event("render targets reset", "");
+            state_snapshot_valid = false;
+            profiler_overlay_invalidate();
+            for(IState* state : states) {
+                state->invalidate_render_targets();
+            }
         } else if(e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F2) {
             engine_render_fps = !engine_render_fps;
+        } else if(e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F3) {
+            engine_write_frame_stats();
+        } else if(e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_F4) {
+            trace_write(trace_path);
         } else {
             states[states.size() - 1]->handle_input(e);
         }
     }
 }
 
+// The simulation always steps in fixed ticks, however long frames take, so game speed doesn't depend on the display rate.
+// Whatever time is left over says how far into the next tick this frame is, which rendering interpolates by
 void update() {
-    states[states.size() - 1]->update(delta);
+    TRACE_SCOPE("update");
+    simulation_accumulator += delta;
+
+    int ticks = 0;
+    while(simulation_accumulator >= SIMULATION_TICK && ticks < MAX_SIMULATION_TICKS_PER_FRAME) {
+        states[states.size() - 1]->update(SIMULATION_TICK);
+        simulation_accumulator -= SIMULATION_TICK;
+        ticks++;
+    }
+
+    // After a long stall, drop the backlog rather than spending every following frame catching up
+    if(simulation_accumulator >= SIMULATION_TICK) {
+        simulation_accumulator = fmodf(simulation_accumulator, SIMULATION_TICK);
+    }
+
+    render_set_interpolation(simulation_accumulator / SIMULATION_TICK);
+    if(states[states.size() - 1]->interpolating) {
+        render_mark_dirty();
+    }
+
+    // The frame graph scrolls every frame, so frames can't be skipped while it's up
+    if(engine_render_fps) {
+        render_mark_dirty();
+    }
 }
-void render() {
+// Returns whether a frame was presented, which is false when nothing changed and the frame was skipped
+bool render() {
+    TRACE_SCOPE("render");
+    // Headless runs wait on image loads so that every run produces the same frames. The snapshot may have been
+    // taken while an image was still a placeholder, so take it again whenever one arrives
+    bool images_uploaded = engine_is_headless ? render_finish_image_loads() : render_update_image_loads();
+    if(images_uploaded) {
+        state_snapshot_valid = false;
+    }
+    if(!render_is_dirty()) {
+        return false;
+    }
+
+    if(engine_render_fps) {
+        profiler_overlay_update();
+    }
     render_clear();
 
-    if(states[states.size() - 1]->render_previous && states.size() != 1) {
-        states[states.size() - 2]->render();
+    // Find the lowest state that shows through the overlays stacked on top of it
+    int top_state = states.size() - 1;
+    int lowest_visible_state = top_state;
+    while(lowest_visible_state > 0 && states[lowest_visible_state]->render_previous) {
+        lowest_visible_state--;
+    }
+
+    if(lowest_visible_state != top_state) {
+        if(!state_snapshot_valid) {
+            render_begin_target(state_snapshot);
+            render_clear_target(COLOR_BLACK);
+            for(int i = lowest_visible_state; i < top_state; i++) {
+                render_set_layer(RENDER_LAYER_UI);
+                states[i]->render();
+            }
+            render_end_target();
+            state_snapshot_valid = true;
+        }
+
+        render_set_layer(RENDER_LAYER_BACKGROUND);
+        render_image(state_snapshot, (vec2) { .x = 0, .y = 0 });
     }
+    render_set_layer(RENDER_LAYER_UI);
     states[states.size() - 1]->render();
 
     if(engine_render_fps) {
-        render_text(("FPS: " + std::to_string(fps)).c_str(), FONT_HACK, COLOR_YELLOW, (vec2) { .x = 0, .y =  0});
-        render_text(("DPS: " + std::to_string(dps)).c_str(), FONT_HACK, COLOR_YELLOW, (vec2) { .x = 0, .y = 10});
+        render_set_layer(RENDER_LAYER_OVERLAY);
+        render_text(scratch_format("FPS: %d", fps), FONT_HACK, COLOR_YELLOW, (vec2) { .x = 0, .y =  0});
+        render_text(scratch_format("DPS: %f", dps), FONT_HACK, COLOR_YELLOW, (vec2) { .x = 0, .y = 10});
+        render_stats_overlay((vec2) { .x = 0, .y = 20 });
+        profiler_overlay_render((vec2) { .x = 0, .y = 60 });
     }
+    frame_stats_begin_phase(FRAME_PHASE_PRESENT);
     render_present();
+    return true;
 }
 
 // Engine functions
 
 bool engine_init(int argc, char** argv) {
+    TRACE_THREAD_NAME("main");
     bool init_fullscreened = false;
 
     // Parse system arguments
-    if(argc == 2) {
-        map_path = argv[1];
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--headless") == 0) {
+            engine_is_headless = true;
+        } else if(strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            headless_frame_limit = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--checksum") == 0) {
+            headless_print_checksums = true;
+        } else if(strcmp(argv[i], "--dump-frames") == 0 && i + 1 < argc) {
+            headless_dump_directory = argv[++i];
+        } else if(strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            target_frame_rate = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--no-vsync") == 0) {
+            vsync_requested = false;
+        } else if(strcmp(argv[i], "--spike-budget") == 0 && i + 1 < argc) {
+            flight_recorder_set_budget(atof(argv[++i]));
+        } else if(strcmp(argv[i], "--flight-dir") == 0 && i + 1 < argc) {
+            flight_recorder_set_directory(argv[++i]);
+        } else if(strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+            trace_write_on_exit = true;
+        } else if(strcmp(argv[i], "--text-backend") == 0 && i + 1 < argc) {
+            i++;
+            if(strcmp(argv[i], "atlas") == 0) {
+                render_set_text_backend(TEXT_BACKEND_GLYPH_ATLAS);
+            } else if(strcmp(argv[i], "cache") == 0) {
+                render_set_text_backend(TEXT_BACKEND_TEXT_CACHE);
+            } else {
+                std::cout << "Unknown text backend " << argv[i] << ", expected atlas or cache" << std::endl;
+            }
+        } else if(strcmp(argv[i], "--text-cache-budget") == 0 && i + 1 < argc) {
+            int budget_kb = atoi(argv[++i]);
+            if(budget_kb > 0) {
+                render_set_text_cache_budget(budget_kb * 1024);
+            } else {
+                std::cout << "Text cache budget must be a positive number of kilobytes" << std::endl;
+            }
+        } else if(strcmp(argv[i], "--frame-stats") == 0 && i + 1 < argc) {
+            frame_stats_path = argv[++i];
+            frame_stats_write_on_exit = true;
+        } else {
+            map_path = argv[i];
+        }
+    }
+
+    if(engine_is_headless) {
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
     }
 
     if(SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -122,8 +309,21 @@ bool engine_init(int argc, char** argv) {
         return false;
     }
 
-    window = SDL_CreateWindow(GAME_TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if(engine_is_headless) {
+        // Render with the software renderer straight into a surface we can read back every frame
+        window = SDL_CreateWindow(GAME_TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_HIDDEN);
+        headless_surface = SDL_CreateRGBSurfaceWithFormat(0, SCREEN_WIDTH, SCREEN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+        if(headless_surface != nullptr) {
+            renderer = SDL_CreateSoftwareRenderer(headless_surface);
+        }
+    } else {
+        window = SDL_CreateWindow(GAME_TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN);
+        Uint32 renderer_flags = SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE;
+        if(vsync_requested) {
+            renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+        }
+        renderer = SDL_CreateRenderer(window, -1, renderer_flags);
+    }
 
     int img_flags = IMG_INIT_PNG;
 
@@ -142,23 +342,47 @@ bool engine_init(int argc, char** argv) {
         return false;
     }
 
+    if(!scratch_init(FRAME_SCRATCH_SIZE)) {
+        return false;
+    }
     if(!render_load_resources()) {
         return false;
     }
+    state_snapshot = render_create_target((vec2) { .x = SCREEN_WIDTH, .y = SCREEN_HEIGHT });
+    render_set_target_premultiplied(state_snapshot);
+    profiler_overlay_init();
 
     engine_set_resolution(resolution_width, resolution_height);
     if(init_fullscreened) {
         engine_toggle_fullscreen();
     }
 
+    // Vsync isn't guaranteed just because it was asked for, so ask the renderer whether it actually got it
+    pacer_init(target_frame_rate);
+    if(!engine_is_headless) {
+        SDL_RendererInfo renderer_info;
+        bool vsync_active = SDL_GetRendererInfo(renderer, &renderer_info) == 0 && (renderer_info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
+        SDL_DisplayMode display_mode;
+        int display_refresh_rate = 0;
+        if(SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &display_mode) == 0) {
+            display_refresh_rate = display_mode.refresh_rate;
+        }
+        pacer_set_vsync(vsync_active, display_refresh_rate);
+    }
+
     return true;
 }
 
 void engine_quit() {
+    profiler_overlay_quit();
     render_free_resources();
+    scratch_quit();
 
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
+    if(headless_surface != nullptr) {
+        SDL_FreeSurface(headless_surface);
+    }
 
     IMG_Quit();
     TTF_Quit();
@@ -171,6 +395,7 @@ void engine_set_resolution(int width, int height) {
     SDL_RenderSetLogicalSize(renderer, SCREEN_WIDTH, SCREEN_HEIGHT);
     SDL_SetWindowSize(window, width, height);
     SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+    render_mark_dirty();
 }
 
 void engine_toggle_fullscreen() {
@@ -180,32 +405,71 @@ void engine_toggle_fullscreen() {
         SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
     }
     engine_is_fullscreen = !engine_is_fullscreen;
+    render_mark_dirty();
 }
 
-void engine_clock_tick() {
+void engine_clock_tick(bool frame_presented) {
+    TRACE_SCOPE("engine_clock_tick");
     frames_this_second++;
-    float current_time = SDL_GetTicks() / 1000.0f;
 
-    // Record delta time
-    delta = current_time - last_update_time;
+    // Headless runs go as fast as they can with a fixed delta, so the simulation is the same from run to run
+    if(engine_is_headless) {
+        delta = SIMULATION_TICK;
+        return;
+    }
+
+    // Wait out the rest of the frame and record delta time
+    delta = (float)pacer_wait(frame_presented);
     deltas_this_second += delta;
-    last_update_time = current_time;
 
     // If one second has passed, record what the fps and dps was during that second
-    if(current_time - last_second_time >= 1.0f) {
+    double current_time = pacer_now();
+    if(current_time - last_second_time >= 1.0) {
+        if(engine_render_fps) {
+            render_mark_dirty();
+        }
         fps = frames_this_second;
         frames_this_second = 0;
         dps = deltas_this_second;
         deltas_this_second = 0;
         last_second_time += 1.0;
     }
+}
+
+
+// Checksums and optionally saves the frame that was just rendered into the headless surface.
+// The checksum is FNV-1a over the visible pixels of each row, so it doesn't depend on the surface pitch
+void engine_capture_headless_frame() {
+    if(headless_print_checksums) {
+        uint64_t checksum = 14695981039346656037ULL;
+        SDL_LockSurface(headless_surface);
+        for(int y = 0; y < headless_surface->h; y++) {
+            const uint8_t* row = (const uint8_t*)headless_surface->pixels + (y * headless_surface->pitch);
+            for(int x = 0; x < headless_surface->w * headless_surface->format->BytesPerPixel; x++) {
+                checksum = (checksum ^ row[x]) * 1099511628211ULL;
+            }
+        }
+        SDL_UnlockSurface(headless_surface);
 
-    // Delay if there's extra time between frames
-    if(current_time - last_frame_time < FRAME_DURATION) {
-        unsigned long delay_time = (unsigned long)(1000.0f * (FRAME_DURATION - (current_time - last_frame_time)));
-        SDL_Delay(delay_time);
+        printf("frame %d checksum %016llx\n", headless_frame, (unsigned long long)checksum);
     }
 
-    last_frame_time = SDL_GetTicks() / 1000.0f;
+    if(headless_dump_directory != "") {
+        char frame_path[512];
+        snprintf(frame_path, sizeof(frame_path), "%s/frame_%05d.png", headless_dump_directory.c_str(), headless_frame);
+        if(IMG_SavePNG(headless_surface, frame_path) != 0) {
+            std::cout << "Unable to save frame " << frame_path << "! SDL Error " << IMG_GetError() << std::endl;
+        }
+    }
+
+    headless_frame++;
+    if(headless_frame_limit != -1 && headless_frame >= headless_frame_limit) {
+        engine_is_running = false;
+    }
 }
 
+void engine_write_frame_stats() {
+    if(frame_stats_write_csv(frame_stats_path + ".csv") && frame_stats_write_json(frame_stats_path + ".json", FRAME_STATS_WINDOW)) {
+        std::cout << "Wrote frame stats to " << frame_stats_path << ".csv and " << frame_stats_path << ".json" << std::endl;
+    }
+}
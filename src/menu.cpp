@@ -7,7 +7,7 @@ Menu::Menu() {}
 Menu::Menu(SDL_Rect rect) {
     this->rect = rect;
     cursor_index = 0;
-    cursor_image = render_load_image("./res/cursor.png");
+    cursor_image = render_load_image_async("./res/cursor.png");
 
     padding_left = 8;
     padding_top = 5;
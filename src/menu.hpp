@@ -1,5 +1,6 @@
 #pragma once
 
+#include "render.hpp"
 #include <SDL2/SDL.h>
 #include <vector>
 #include <string>
@@ -20,5 +21,5 @@ class Menu {
     private:
         SDL_Rect rect;
         int cursor_index;
-        int cursor_image;
+        ImageHandle cursor_image;
 };
@@ -0,0 +1,91 @@
+#include "pacer.hpp"
+
+#include <SDL2/SDL.h>
+
+// Below this much time left before the deadline the pacer stops sleeping and spins instead
+const double PACER_SPIN_THRESHOLD = 0.002;
+// Rate skipped frames are held to when running uncapped and the display didn't report its refresh rate
+const int PACER_IDLE_RATE = 60;
+
+Uint64 pacer_frequency = 1;
+Uint64 pacer_start_counter = 0;
+double pacer_frame_duration = 0.0; // 0 means uncapped
+double pacer_next_deadline = 0.0;
+double pacer_last_frame_time = 0.0;
+bool pacer_vsync_active = false;
+int pacer_display_refresh_rate = 0;
+
+// A target rate of 0 or less runs uncapped
+void pacer_init(int target_rate) {
+    pacer_frequency = SDL_GetPerformanceFrequency();
+    pacer_start_counter = SDL_GetPerformanceCounter();
+    pacer_set_target_rate(target_rate);
+    pacer_last_frame_time = 0.0;
+    pacer_next_deadline = pacer_frame_duration;
+}
+
+void pacer_set_target_rate(int target_rate) {
+    pacer_frame_duration = target_rate > 0 ? 1.0 / target_rate : 0.0;
+    pacer_next_deadline = pacer_now() + pacer_frame_duration;
+}
+
+// A refresh rate of 0 means the display didn't report one, in which case vsync is trusted to do all the pacing
+void pacer_set_vsync(bool vsync_active, int display_refresh_rate) {
+    pacer_vsync_active = vsync_active;
+    pacer_display_refresh_rate = display_refresh_rate;
+}
+
+// Seconds since pacer_init
+double pacer_now() {
+    return (double)(SDL_GetPerformanceCounter() - pacer_start_counter) / (double)pacer_frequency;
+}
+
+// How long a presented frame is meant to take in seconds, from the target rate or else the display's refresh when
+// vsync is on. 0 means frames aren't paced at all
+double pacer_get_frame_duration() {
+    if(pacer_frame_duration != 0.0) {
+        return pacer_frame_duration;
+    }
+    if(pacer_vsync_active && pacer_display_refresh_rate > 0) {
+        return 1.0 / pacer_display_refresh_rate;
+    }
+
+    return 0.0;
+}
+
+// Waits out the rest of the current frame and returns how long it was since the previous call returned
+double pacer_wait(bool presented) {
+    bool vsync_paces_frames = presented && pacer_vsync_active
+        && (pacer_display_refresh_rate == 0 || pacer_frame_duration * pacer_display_refresh_rate <= 1.0);
+
+    // A frame that wasn't presented never blocked on vsync, so even uncapped it's held to the display's rate
+    // rather than letting an idle scene spin through frames as fast as it can
+    double idle_duration = pacer_frame_duration != 0.0 ? pacer_frame_duration
+        : 1.0 / (pacer_display_refresh_rate > 0 ? pacer_display_refresh_rate : PACER_IDLE_RATE);
+    double frame_duration = presented ? pacer_frame_duration : idle_duration;
+
+    if(vsync_paces_frames || frame_duration == 0.0) {
+        // Keep the deadline current so that the first skipped frame after a run of presented ones still waits
+        pacer_next_deadline = pacer_now() + idle_duration;
+    } else {
+        double remaining = pacer_next_deadline - pacer_now();
+        if(remaining > PACER_SPIN_THRESHOLD) {
+            SDL_Delay((Uint32)((remaining - PACER_SPIN_THRESHOLD) * 1000.0));
+        }
+        while(pacer_now() < pacer_next_deadline) {
+        }
+
+        // Deadlines advance by exactly one frame so that rounding doesn't accumulate into drift, but if we've
+        // fallen more than a frame behind there's no catching up, so start again from now
+        pacer_next_deadline += frame_duration;
+        double now = pacer_now();
+        if(now > pacer_next_deadline) {
+            pacer_next_deadline = now + frame_duration;
+        }
+    }
+
+    double now = pacer_now();
+    double frame_time = now - pacer_last_frame_time;
+    pacer_last_frame_time = now;
+    return frame_time;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Frame pacer built on the high resolution performance counter. It sleeps while the next frame deadline is still
+// far off and spins through the last stretch, since SDL_Delay only wakes to the nearest millisecond or worse.
+// When the frame was presented, the renderer is waiting on vsync and the target rate is at least the display's,
+// present already blocked so it only measures time. Frames that were skipped without presenting are always waited on
+void pacer_init(int target_rate);
+void pacer_set_target_rate(int target_rate);
+void pacer_set_vsync(bool vsync_active, int display_refresh_rate);
+double pacer_now();
+double pacer_get_frame_duration();
+double pacer_wait(bool presented);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+// Shared by the game and the atlas packer, so that "./res/a.png", "res//a.png" and "res/a.png"
+// all name the same atlas entry
+inline std::string path_canonicalize(std::string path) {
+    while(path.rfind("./", 0) == 0) {
+        path = path.substr(2);
+    }
+
+    std::size_t index;
+    while((index = path.find("/./")) != std::string::npos) {
+        path.erase(index, 2);
+    }
+    while((index = path.find("//")) != std::string::npos) {
+        path.erase(index, 1);
+    }
+
+    return path;
+}
@@ -0,0 +1,142 @@
+#include "profiler_overlay.hpp"
+
+#include "render.hpp"
+#include "frame_stats.hpp"
+#include "pacer.hpp"
+#include "scratch.hpp"
+#include <algorithm>
+
+const int PROFILER_GRAPH_WIDTH = 240; // One column per frame
+const int PROFILER_GRAPH_HEIGHT = 60;
+const float PROFILER_GRAPH_MS = 33.3f; // Frame time at the top of the graph
+const int PROFILER_LINE_HEIGHT = 10;
+
+// Colors for every phase that's stacked, total isn't since it's the whole bar plus pacing
+const SDL_Color PROFILER_PHASE_COLORS[FRAME_PHASE_TOTAL] = {
+    (SDL_Color) { .r = 120, .g = 120, .b = 120, .a = 255 }, // input
+    (SDL_Color) { .r = 200, .g = 200, .b = 200, .a = 255 }, // update
+    (SDL_Color) { .r =  80, .g = 160, .b = 255, .a = 255 }, // player
+    (SDL_Color) { .r = 190, .g = 110, .b = 255, .a = 255 }, // scripts
+    (SDL_Color) { .r =  80, .g = 220, .b =  80, .a = 255 }, // actors
+    (SDL_Color) { .r = 255, .g =  80, .b =  80, .a = 255 }, // collision
+    (SDL_Color) { .r =  80, .g = 220, .b = 220, .a = 255 }, // camera
+    (SDL_Color) { .r = 255, .g = 160, .b =  40, .a = 255 }, // render
+    (SDL_Color) { .r = 255, .g = 230, .b =  80, .a = 255 }, // present
+};
+const SDL_Color PROFILER_BACKGROUND_COLOR = (SDL_Color) { .r = 0, .g = 0, .b = 0, .a = 255 };
+
+ImageHandle profiler_graph = IMAGE_HANDLE_NONE;
+unsigned long profiler_next_frame = 0; // The next frame that doesn't have a column yet
+int profiler_next_column = 0;
+bool profiler_graph_lost = false; // Set when the renderer reset the graph target, so it's cleared and redrawn from the history
+int profiler_actor_count = 0;
+int profiler_collider_count = 0;
+int profiler_dialog_line_count = 0;
+
+void profiler_overlay_init() {
+    profiler_graph = render_create_target((vec2) { .x = PROFILER_GRAPH_WIDTH, .y = PROFILER_GRAPH_HEIGHT });
+    if(profiler_graph == IMAGE_HANDLE_NONE) {
+        return;
+    }
+
+    render_begin_target(profiler_graph);
+    render_clear_target(PROFILER_BACKGROUND_COLOR);
+    render_end_target();
+}
+
+void profiler_overlay_quit() {
+    render_unload_image(profiler_graph);
+    profiler_graph = IMAGE_HANDLE_NONE;
+}
+
+void profiler_overlay_set_scene_counts(int actors, int colliders, int dialog_lines) {
+    profiler_actor_count = actors;
+    profiler_collider_count = colliders;
+    profiler_dialog_line_count = dialog_lines;
+}
+
+void profiler_overlay_invalidate() {
+    profiler_graph_lost = true;
+}
+
+// Draws the columns for frames that have finished since the last call. This switches render targets,
+// so call it before anything is queued for the screen
+void profiler_overlay_update() {
+    int frame_count = frame_stats_get_frame_count();
+    if(profiler_graph == IMAGE_HANDLE_NONE || frame_count < 2) {
+        return;
+    }
+
+    if(profiler_graph_lost) {
+        render_begin_target(profiler_graph);
+        render_clear_target(PROFILER_BACKGROUND_COLOR);
+        render_end_target();
+        profiler_next_frame = 0;
+        profiler_graph_lost = false;
+    }
+
+    // Frames that fell out of the history, or that there isn't room on the graph for, are skipped
+    unsigned long newest_frame = frame_stats_get_frame(1).frame;
+    unsigned long oldest_frame = newest_frame - std::min(frame_count - 1, PROFILER_GRAPH_WIDTH) + 1;
+    if(profiler_next_frame < oldest_frame) {
+        profiler_next_frame = oldest_frame;
+    }
+    if(profiler_next_frame > newest_frame) {
+        return;
+    }
+
+    render_begin_target(profiler_graph);
+    render_set_layer(RENDER_LAYER_UI);
+    for(; profiler_next_frame <= newest_frame; profiler_next_frame++) {
+        const FrameTiming& timing = frame_stats_get_frame((int)(newest_frame - profiler_next_frame) + 1);
+
+        int x = profiler_next_column;
+        render_fill_rect((SDL_Rect) { .x = x, .y = 0, .w = 1, .h = PROFILER_GRAPH_HEIGHT }, PROFILER_BACKGROUND_COLOR);
+        float bar_ms = 0.0f;
+        for(int phase = 0; phase < FRAME_PHASE_TOTAL; phase++) {
+            // Stack by cumulative time so that rounding doesn't make the bar drift away from the total
+            int bottom = (int)(bar_ms * PROFILER_GRAPH_HEIGHT / PROFILER_GRAPH_MS);
+            bar_ms += timing.phase_ms[phase];
+            int top = std::min((int)(bar_ms * PROFILER_GRAPH_HEIGHT / PROFILER_GRAPH_MS), PROFILER_GRAPH_HEIGHT);
+            if(top > bottom) {
+                render_fill_rect((SDL_Rect) { .x = x, .y = PROFILER_GRAPH_HEIGHT - top, .w = 1, .h = top - bottom }, PROFILER_PHASE_COLORS[phase]);
+            }
+        }
+
+        profiler_next_column = (profiler_next_column + 1) % PROFILER_GRAPH_WIDTH;
+    }
+    render_end_target();
+}
+
+void profiler_overlay_render(vec2 position) {
+    const char* counts = scratch_format("Actors: %d Colliders: %d Tex: %d Dialog: %d", profiler_actor_count,
+        profiler_collider_count, render_get_texture_count(), profiler_dialog_line_count);
+    render_text(counts, FONT_HACK, COLOR_YELLOW, position);
+
+    // Unroll the ring so the oldest column is on the left and the newest is on the right
+    vec2 graph_position = (vec2) { .x = position.x, .y = position.y + PROFILER_LINE_HEIGHT };
+    int split = profiler_next_column;
+    if(split != PROFILER_GRAPH_WIDTH) {
+        render_image_rect(profiler_graph, (SDL_Rect) { .x = split, .y = 0, .w = PROFILER_GRAPH_WIDTH - split, .h = PROFILER_GRAPH_HEIGHT }, graph_position, false);
+    }
+    if(split != 0) {
+        render_image_rect(profiler_graph, (SDL_Rect) { .x = 0, .y = 0, .w = split, .h = PROFILER_GRAPH_HEIGHT },
+            (vec2) { .x = graph_position.x + PROFILER_GRAPH_WIDTH - split, .y = graph_position.y }, false);
+    }
+
+    // The budget line marks the pacer's frame duration, uncapped frames have no budget to draw. Budgets longer than
+    // the graph is tall are drawn along its top
+    float budget_ms = (float)(pacer_get_frame_duration() * 1000.0);
+    if(budget_ms > 0.0f) {
+        int budget_height = std::min((int)(budget_ms * PROFILER_GRAPH_HEIGHT / PROFILER_GRAPH_MS), PROFILER_GRAPH_HEIGHT);
+        int budget_y = graph_position.y + PROFILER_GRAPH_HEIGHT - budget_height;
+        render_fill_rect((SDL_Rect) { .x = graph_position.x, .y = budget_y, .w = PROFILER_GRAPH_WIDTH, .h = 1 }, COLOR_WHITE);
+    }
+
+    // Legend under the graph, the first two letters of each phase's name in its color
+    vec2 legend_position = (vec2) { .x = graph_position.x, .y = graph_position.y + PROFILER_GRAPH_HEIGHT + 1 };
+    for(int phase = 0; phase < FRAME_PHASE_TOTAL; phase++) {
+        render_text(FRAME_PHASE_NAMES[phase], 2, FONT_HACK, PROFILER_PHASE_COLORS[phase], legend_position);
+        legend_position.x += render_get_text_width(FRAME_PHASE_NAMES[phase], 2, FONT_HACK) + 4;
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "vector.hpp"
+
+// The F2 overlay's frame graph, a bar per frame stacked by phase for the last few hundred frames.
+// The bars are kept in a render target that works as a ring, so each frame only draws the columns for frames
+// that finished since the last update and the graph is shown with two quads no matter how many frames it covers
+void profiler_overlay_init();
+void profiler_overlay_quit();
+void profiler_overlay_set_scene_counts(int actors, int colliders, int dialog_lines);
+void profiler_overlay_update();
+void profiler_overlay_invalidate();
+void profiler_overlay_render(vec2 position);
@@ -1,19 +1,139 @@
 #include "render.hpp"
+#include "image_loader.hpp"
+#include "scratch.hpp"
+#include "trace.hpp"
+#include "flight_recorder.hpp"
+#include "path.hpp"
+#include "json.hpp"
 #include <SDL2/SDL_image.h>
 #include <SDL2/SDL_ttf.h>
 #include <iostream>
+#include <fstream>
 #include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
 
 const int RENDER_POSITION_CENTERED = -1;
 const SDL_Color COLOR_WHITE = (SDL_Color) { .r = 255, .g = 255, .b = 255, .a = 255 };
 const SDL_Color COLOR_BLACK = (SDL_Color) { .r = 0, .g = 0, .b = 0, .a = 0 };
 const SDL_Color COLOR_YELLOW = (SDL_Color) { .r = 255, .g = 255, .b = 0, .a = 255 };
 
+using nlohmann::json;
+
+const char* ATLAS_MANIFEST_PATH = "./res/atlas/manifest.json";
+const int GLYPH_FIRST = 32;
+const int GLYPH_LAST = 126;
+const int GLYPH_COUNT = GLYPH_LAST - GLYPH_FIRST + 1;
+const int GLYPH_ATLAS_COLUMNS = 16;
+
+typedef struct Glyph {
+    SDL_Rect rect;
+    int advance;
+} Glyph;
+
+typedef struct GlyphAtlas {
+    SDL_Texture* texture;
+    vec2 size;
+    Glyph glyphs[GLYPH_COUNT];
+    int line_height;
+} GlyphAtlas;
+
+typedef struct ImageSlot {
+    Image image;
+    std::string path;
+    int generation;
+    bool in_use;
+    bool loading;
+} ImageSlot;
+
+typedef struct RenderTargetState {
+    ImageHandle target;
+    RenderLayer layer;
+    int sort_key;
+} RenderTargetState;
+
+typedef struct AtlasEntry {
+    int page;
+    SDL_Rect rect;
+} AtlasEntry;
+
+typedef struct RenderCommand {
+    SDL_Texture* texture;
+    vec2 texture_size;
+    SDL_Rect src_rect;
+    SDL_Rect dst_rect;
+    bool flipped;
+    SDL_Color color;
+} RenderCommand;
+
+typedef struct RenderSortEntry {
+    uint64_t key;
+    uint32_t command_index;
+} RenderSortEntry;
+
+typedef struct RenderBatch {
+    SDL_Texture* texture;
+    std::vector<SDL_Vertex> vertices;
+    std::vector<int> indices;
+} RenderBatch;
+
+typedef struct TextCacheEntry {
+    uint64_t key;
+    std::string text;
+    Font font;
+    SDL_Color color;
+    Image* image;
+    int bytes;
+    unsigned long last_used_frame;
+} TextCacheEntry;
+
 // Resources
 TTF_Font** fonts;
-std::vector<Image> images;
-std::vector<std::string> image_paths;
-int dialog_box_image;
+GlyphAtlas* glyph_atlases;
+std::vector<ImageSlot> image_slots;
+std::vector<int> free_image_slots;
+std::unordered_map<std::string, ImageHandle> image_registry;
+std::unordered_set<ImageHandle> reported_image_handles; // Bad handles that have already been logged, since they tend to be drawn every frame
+std::vector<Image> atlas_pages;
+std::unordered_map<std::string, AtlasEntry> atlas_entries;
+ImageHandle dialog_box_image;
+
+// Text state
+TextBackend text_backend = TEXT_BACKEND_GLYPH_ATLAS;
+std::list<TextCacheEntry> text_cache; // Most recently used entries at the front
+std::unordered_map<uint64_t, std::list<TextCacheEntry>::iterator> text_cache_lookup;
+int text_cache_budget = 4 * 1024 * 1024;
+TextCacheStats text_cache_stats = (TextCacheStats) { .hits = 0, .misses = 0, .evictions = 0, .entries = 0, .bytes = 0 };
+unsigned long render_frame = 0;
+RenderStats render_stats;
+RenderStats render_last_frame_stats;
+SDL_Texture* render_bound_texture = nullptr;
+bool render_frame_dirty = true;
+float render_interpolation = 1.0f;
+int render_target_count = 0;
+int render_texture_count = 0;
+SDL_Texture* white_texture = nullptr; // Single white pixel, tinted by vertex color to draw solid rects
+std::vector<RenderTargetState> render_target_stack;
+
+// Command queue state
+const bool RENDER_LAYER_Y_SORTED[RENDER_LAYER_COUNT] = { false, true, false, false, false };
+RenderLayer render_layer = RENDER_LAYER_UI;
+int render_sort_key = 0;
+uint32_t render_sequence = 0;
+std::vector<RenderCommand> render_commands;
+std::vector<RenderSortEntry> render_sort_entries;
+std::vector<RenderSortEntry> render_sort_scratch;
+std::unordered_map<SDL_Texture*, uint32_t> texture_ids;
+uint32_t next_texture_id = 0; // Only ever counts up, since destroyed textures leave gaps in texture_ids
+
+// Batch state, batches are reused between frames so that their buffers keep their capacity
+std::vector<RenderBatch> batches;
+std::size_t batch_count = 0;
 
 // Resource management functions
 
@@ -22,20 +142,60 @@ bool render_load_resources() {
     render_load_font(FONT_HACK, "./res/hack.ttf", 10);
     render_load_font(FONT_HELVETICA, "./res/helvetica_mono.ttf", 14);
 
+    // The atlas is optional, without it every image is loaded as its own texture
+    render_load_atlas(ATLAS_MANIFEST_PATH);
+
+    glyph_atlases = new GlyphAtlas[FONT_COUNT];
+    for(int i = 0; i < FONT_COUNT; i++) {
+        if(!render_build_glyph_atlas((Font)i)) {
+            return false;
+        }
+    }
+
     dialog_box_image = render_load_spritesheet("./res/dialogbox.png", (vec2){ .x = 16, .y = 16 });
 
+    SDL_Surface* white_surface = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_RGBA32);
+    if(white_surface == nullptr) {
+        std::cout << "Unable to create fill surface! SDL Error " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_FillRect(white_surface, nullptr, 0xFFFFFFFF);
+    white_texture = render_create_texture_from_surface(white_surface);
+    SDL_FreeSurface(white_surface);
+    if(white_texture == nullptr) {
+        std::cout << "Unable to create fill texture! SDL Error " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // Started last so that none of the failures above leave joinable workers behind
+    image_loader_init(SDL_GetCPUCount() - 1);
+
     return true;
 }
 
 void render_free_resources() {
+    image_loader_quit();
+
     for(int i = 0; i < FONT_COUNT; i++) {
         TTF_CloseFont(fonts[i]);
+        render_destroy_texture(glyph_atlases[i].texture);
     }
     delete [] fonts;
+    delete [] glyph_atlases;
+
+    render_clear_text_cache();
+    render_destroy_texture(white_texture);
 
-    for(int i = 0; i < images.size(); i++) {
-        SDL_DestroyTexture(images[i].texture);
+    for(ImageSlot& slot : image_slots) {
+        if(slot.in_use && slot.image.owns_texture && slot.image.texture != nullptr) {
+            render_destroy_texture(slot.image.texture);
+        }
     }
+    image_slots.clear();
+    free_image_slots.clear();
+    image_registry.clear();
+    reported_image_handles.clear();
+    render_unload_atlas();
 }
 
 void render_load_font(Font font, std::string path, int size) {
@@ -46,71 +206,752 @@ void render_load_font(Font font, std::string path, int size) {
     }
 }
 
-int render_load_image(std::string path) {
-    for(int i = 0; i < images.size(); i++) {
-        bool image_already_loaded = path == image_paths[i];
-        if(image_already_loaded) {
-            return i;
+// Rasterizes the printable ASCII range of a font once into a single white texture so that text
+// can be drawn as one quad per glyph, tinted with the texture color mod, instead of going through TTF every call
+bool render_build_glyph_atlas(Font font) {
+    GlyphAtlas& atlas = glyph_atlases[font];
+    atlas.texture = nullptr;
+    atlas.line_height = TTF_FontHeight(fonts[font]);
+
+    SDL_Surface* glyph_surfaces[GLYPH_COUNT];
+    int cell_width = 0;
+    for(int i = 0; i < GLYPH_COUNT; i++) {
+        glyph_surfaces[i] = TTF_RenderGlyph_Solid(fonts[font], GLYPH_FIRST + i, COLOR_WHITE);
+        render_stats.text_rasterizations++;
+        if(glyph_surfaces[i] != nullptr && glyph_surfaces[i]->w > cell_width) {
+            cell_width = glyph_surfaces[i]->w;
+        }
+
+        int advance = 0;
+        TTF_GlyphMetrics(fonts[font], GLYPH_FIRST + i, NULL, NULL, NULL, NULL, &advance);
+        atlas.glyphs[i].advance = advance;
+    }
+
+    int rows = (GLYPH_COUNT + GLYPH_ATLAS_COLUMNS - 1) / GLYPH_ATLAS_COLUMNS;
+    SDL_Surface* atlas_surface = SDL_CreateRGBSurfaceWithFormat(0, cell_width * GLYPH_ATLAS_COLUMNS, atlas.line_height * rows, 32, SDL_PIXELFORMAT_RGBA32);
+    if(atlas_surface == nullptr) {
+        std::cout << "Unable to create glyph atlas surface! SDL Error " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_FillRect(atlas_surface, NULL, 0);
+
+    for(int i = 0; i < GLYPH_COUNT; i++) {
+        Glyph& glyph = atlas.glyphs[i];
+        glyph.rect = (SDL_Rect) {
+            .x = (i % GLYPH_ATLAS_COLUMNS) * cell_width,
+            .y = (i / GLYPH_ATLAS_COLUMNS) * atlas.line_height,
+            .w = 0,
+            .h = atlas.line_height
+        };
+        if(glyph_surfaces[i] == nullptr) {
+            continue;
+        }
+
+        glyph.rect.w = glyph_surfaces[i]->w;
+        SDL_Rect dst_rect = glyph.rect;
+        SDL_BlitSurface(glyph_surfaces[i], NULL, atlas_surface, &dst_rect);
+        SDL_FreeSurface(glyph_surfaces[i]);
+    }
+
+    atlas.texture = render_create_texture_from_surface(atlas_surface);
+    atlas.size = (vec2) { .x = atlas_surface->w, .y = atlas_surface->h };
+    SDL_FreeSurface(atlas_surface);
+    if(atlas.texture == nullptr) {
+        std::cout << "Unable to create glyph atlas texture! SDL Error " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool render_load_atlas(std::string manifest_path) {
+    std::ifstream manifest_file;
+    manifest_file.open(manifest_path);
+    if(!manifest_file.is_open()) {
+        return false;
+    }
+    json manifest_json = json::parse(manifest_file);
+    manifest_file.close();
+
+    for(json page_json : manifest_json["pages"]) {
+        std::string page_path = page_json.get<std::string>();
+        SDL_Surface* page_surface = IMG_Load(page_path.c_str());
+        if(page_surface == nullptr) {
+            std::cout << "Unable to load atlas page " << page_path << "! SDL Error " << IMG_GetError() << std::endl;
+            render_unload_atlas();
+            return false;
         }
+
+        Image page;
+        page.texture = render_create_texture_from_surface(page_surface);
+        page.texture_size = (vec2) { .x = page_surface->w, .y = page_surface->h };
+        SDL_FreeSurface(page_surface);
+        if(page.texture == nullptr) {
+            std::cout << "Unable to create atlas page texture! SDL Error " << SDL_GetError() << std::endl;
+            render_unload_atlas();
+            return false;
+        }
+        atlas_pages.push_back(page);
+    }
+
+    for(auto& [path, entry_json] : manifest_json["images"].items()) {
+        int page = entry_json["page"].get<int>();
+        if(page < 0 || page >= (int)atlas_pages.size()) {
+            std::cout << "Unable to load atlas, image " << path << " is on page " << page << " which the manifest doesn't list!" << std::endl;
+            render_unload_atlas();
+            return false;
+        }
+        atlas_entries[path_canonicalize(path)] = (AtlasEntry) {
+            .page = page,
+            .rect = (SDL_Rect) {
+                .x = entry_json["rect"][0].get<int>(),
+                .y = entry_json["rect"][1].get<int>(),
+                .w = entry_json["rect"][2].get<int>(),
+                .h = entry_json["rect"][3].get<int>()
+            }
+        };
+    }
+
+    return true;
+}
+
+// Also used to back out of a partly loaded atlas, so images fall back to loading from their own files
+void render_unload_atlas() {
+    for(Image& page : atlas_pages) {
+        render_destroy_texture(page.texture);
+    }
+    atlas_pages.clear();
+    atlas_entries.clear();
+}
+
+// Textures are created and destroyed through these so that they're counted in the render stats
+SDL_Texture* render_create_texture_from_surface(SDL_Surface* surface) {
+    SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
+    if(texture != nullptr) {
+        render_stats.textures_created++;
+        render_texture_count++;
+    }
+
+    return texture;
+}
+
+void render_destroy_texture(SDL_Texture* texture) {
+    texture_ids.erase(texture);
+    if(render_bound_texture == texture) {
+        render_bound_texture = nullptr;
+    }
+    SDL_DestroyTexture(texture);
+    render_stats.textures_destroyed++;
+    render_texture_count--;
+}
+
+// Image registry
+
+ImageHandle render_make_image_handle(int slot_index, int generation) {
+    return (ImageHandle)((generation & IMAGE_HANDLE_GENERATION_MASK) << IMAGE_HANDLE_INDEX_BITS) | slot_index;
+}
+
+bool render_image_handle_valid(ImageHandle handle) {
+    if(handle < 0) {
+        return false;
+    }
+
+    int slot_index = handle & IMAGE_HANDLE_INDEX_MASK;
+    int generation = (handle >> IMAGE_HANDLE_INDEX_BITS) & IMAGE_HANDLE_GENERATION_MASK;
+    return slot_index < (int)image_slots.size()
+        && image_slots[slot_index].in_use
+        && (image_slots[slot_index].generation & IMAGE_HANDLE_GENERATION_MASK) == generation;
+}
+
+// IMAGE_HANDLE_NONE is what a failed or never made load leaves behind, so it quietly draws nothing
+Image* render_get_image(ImageHandle handle) {
+    if(handle == IMAGE_HANDLE_NONE) {
+        return nullptr;
+    }
+    if(!render_image_handle_valid(handle)) {
+        if(reported_image_handles.insert(handle).second) {
+            std::cout << "Image handle " << handle << " is stale or invalid!" << std::endl;
+        }
+        return nullptr;
+    }
+
+    return &image_slots[handle & IMAGE_HANDLE_INDEX_MASK].image;
+}
+
+ImageHandle render_register_image(std::string canonical_path, const Image& image) {
+    int slot_index;
+    if(!free_image_slots.empty()) {
+        slot_index = free_image_slots.back();
+        free_image_slots.pop_back();
+    } else {
+        if(image_slots.size() > IMAGE_HANDLE_INDEX_MASK) {
+            std::cout << "Unable to register image " << canonical_path << ", the image registry is full!" << std::endl;
+            return IMAGE_HANDLE_NONE;
+        }
+        slot_index = image_slots.size();
+        image_slots.push_back((ImageSlot) { .image = Image(), .path = "", .generation = 0, .in_use = false, .loading = false });
+    }
+
+    ImageSlot& slot = image_slots[slot_index];
+    slot.image = image;
+    slot.path = canonical_path;
+    slot.in_use = true;
+    slot.loading = false;
+
+    ImageHandle handle = render_make_image_handle(slot_index, slot.generation);
+    image_registry[canonical_path] = handle;
+
+    return handle;
+}
+
+ImageHandle render_load_image(std::string path) {
+    TRACE_SCOPE("render_load_image");
+    std::string canonical_path = path_canonicalize(path);
+
+    auto registered_image = image_registry.find(canonical_path);
+    if(registered_image != image_registry.end()) {
+        return registered_image->second;
+    }
+
+    // Images packed into the atlas share their page's texture instead of getting one of their own
+    auto atlas_entry = atlas_entries.find(canonical_path);
+    if(atlas_entry != atlas_entries.end()) {
+        const Image& page = atlas_pages[atlas_entry->second.page];
+        const SDL_Rect& rect = atlas_entry->second.rect;
+
+        Image new_image;
+        new_image.texture = page.texture;
+        new_image.texture_size = page.texture_size;
+        new_image.offset = (vec2) { .x = rect.x, .y = rect.y };
+        new_image.size = (vec2) { .x = rect.w, .y = rect.h };
+        new_image.frame_size = new_image.size;
+        new_image.owns_texture = false;
+
+        return render_register_image(canonical_path, new_image);
     }
 
     SDL_Surface* loaded_surface = IMG_Load(path.c_str());
     if(loaded_surface == nullptr) {
         std::cout << "Unable to load image " << path << "! SDL Error " << IMG_GetError() << std::endl;
-        return -1;
+        return IMAGE_HANDLE_NONE;
     }
 
     Image new_image;
-    new_image.texture = SDL_CreateTextureFromSurface(renderer, loaded_surface);
+    new_image.texture = render_create_texture_from_surface(loaded_surface);
     if(new_image.texture == nullptr) {
         std::cout << "Unable to create image texture! SDL Error " << SDL_GetError() << std::endl;
-        return -1;
+        SDL_FreeSurface(loaded_surface);
+        return IMAGE_HANDLE_NONE;
     }
     new_image.size = (vec2) {  .x = loaded_surface->w, .y = loaded_surface->h };
+    new_image.texture_size = new_image.size;
+    new_image.offset = (vec2) { .x = 0, .y = 0 };
     new_image.frame_size = (vec2) { .x = new_image.size.x, .y = new_image.size.y };
-
-    images.push_back(new_image);
-    image_paths.push_back(path);
+    new_image.owns_texture = true;
 
     SDL_FreeSurface(loaded_surface);
+    flight_recorder_event("image loaded", canonical_path.c_str());
+
+    return render_register_image(canonical_path, new_image);
+}
+
+ImageHandle render_load_spritesheet(std::string path, vec2 frame_size) {
+    ImageHandle handle = render_load_image(path);
+    Image* image = render_get_image(handle);
+    if(image != nullptr) {
+        image->frame_size = frame_size;
+    }
+
+    return handle;
+}
+
+// Registers a placeholder for the image and hands the decode to the loader's worker threads.
+// The placeholder draws nothing until render_update_image_loads uploads the decoded surface
+ImageHandle render_load_image_async(std::string path) {
+    std::string canonical_path = path_canonicalize(path);
+
+    auto registered_image = image_registry.find(canonical_path);
+    if(registered_image != image_registry.end()) {
+        return registered_image->second;
+    }
+
+    // Atlas images don't need decoding, so there's no reason to defer them
+    if(atlas_entries.find(canonical_path) != atlas_entries.end()) {
+        return render_load_image(path);
+    }
+
+    Image placeholder;
+    placeholder.texture = nullptr;
+    placeholder.texture_size = (vec2) { .x = 0, .y = 0 };
+    placeholder.offset = (vec2) { .x = 0, .y = 0 };
+    placeholder.size = (vec2) { .x = 0, .y = 0 };
+    placeholder.frame_size = (vec2) { .x = 0, .y = 0 };
+    placeholder.owns_texture = true;
+
+    ImageHandle handle = render_register_image(canonical_path, placeholder);
+    if(handle == IMAGE_HANDLE_NONE) {
+        return IMAGE_HANDLE_NONE;
+    }
+    image_slots[handle & IMAGE_HANDLE_INDEX_MASK].loading = true;
+    image_loader_request(path, handle);
+
+    return handle;
+}
+
+ImageHandle render_load_spritesheet_async(std::string path, vec2 frame_size) {
+    ImageHandle handle = render_load_image_async(path);
+    Image* image = render_get_image(handle);
+    if(image != nullptr) {
+        image->frame_size = frame_size;
+    }
+
+    return handle;
+}
+
+bool render_image_is_loaded(ImageHandle handle) {
+    return render_image_handle_valid(handle) && !image_slots[handle & IMAGE_HANDLE_INDEX_MASK].loading;
+}
+
+void render_upload_image_load(const ImageLoadResult& result) {
+    TRACE_SCOPE("render_upload_image_load");
+    // The image may have been unloaded while it was being decoded
+    if(!render_image_handle_valid(result.request_id)) {
+        SDL_FreeSurface(result.surface);
+        return;
+    }
+
+    ImageSlot& slot = image_slots[result.request_id & IMAGE_HANDLE_INDEX_MASK];
+    slot.loading = false;
+    if(result.surface == nullptr) {
+        flight_recorder_event("image load failed", result.path.c_str());
+        return;
+    }
 
-    return images.size() - 1;
+    Image& image = slot.image;
+    image.texture = render_create_texture_from_surface(result.surface);
+    if(image.texture == nullptr) {
+        std::cout << "Unable to create image texture! SDL Error " << SDL_GetError() << std::endl;
+    } else {
+        image.size = (vec2) { .x = result.surface->w, .y = result.surface->h };
+        image.texture_size = image.size;
+        if(image.frame_size.x == 0 && image.frame_size.y == 0) {
+            image.frame_size = image.size;
+        }
+        flight_recorder_event("image loaded", result.path.c_str());
+    }
+    SDL_FreeSurface(result.surface);
 }
 
-int render_load_spritesheet(std::string path, vec2 frame_size) {
-    int image_index = render_load_image(path);
-    images[image_index].frame_size = frame_size;
+// Uploads whatever the workers have finished decoding without waiting on the rest
+// Returns whether anything was uploaded, so callers holding on to what was drawn before know it may be out of date
+bool render_update_image_loads() {
+    bool uploaded = false;
+    ImageLoadResult result;
+    while(image_loader_poll(result, false)) {
+        render_upload_image_load(result);
+        render_mark_dirty();
+        uploaded = true;
+    }
 
-    return image_index;
+    return uploaded;
 }
 
-std::string render_get_path(int image_index) {
-    return image_paths[image_index];
+// Blocks until every requested image has been decoded and uploaded
+bool render_finish_image_loads() {
+    bool uploaded = false;
+    ImageLoadResult result;
+    while(image_loader_poll(result, true)) {
+        render_upload_image_load(result);
+        uploaded = true;
+    }
+
+    return uploaded;
 }
 
-vec2 render_get_frame_size(int image_index) {
-    return images[image_index].frame_size;
+// Render targets
+
+// Creates a blank texture that can be drawn into with render_begin_target and drawn like any other image afterwards
+ImageHandle render_create_target(vec2 size) {
+    Image new_image;
+    new_image.texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, size.x, size.y);
+    if(new_image.texture == nullptr) {
+        std::cout << "Unable to create render target texture! SDL Error " << SDL_GetError() << std::endl;
+        return IMAGE_HANDLE_NONE;
+    }
+    render_stats.textures_created++;
+    render_texture_count++;
+    SDL_SetTextureBlendMode(new_image.texture, SDL_BLENDMODE_BLEND);
+    new_image.size = size;
+    new_image.texture_size = size;
+    new_image.offset = (vec2) { .x = 0, .y = 0 };
+    new_image.frame_size = size;
+    new_image.owns_texture = true;
+
+    // Targets have no file behind them, so give each one a unique registry key
+    render_target_count++;
+    return render_register_image("<render target " + std::to_string(render_target_count) + ">", new_image);
+}
+
+// Alpha blending into a transparent target already multiplies the color by alpha, so a target that's drawn over
+// other things with partly transparent pixels has to skip that step when it's drawn, or its soft edges darken twice
+bool render_set_target_premultiplied(ImageHandle target) {
+    Image* image = render_get_image(target);
+    if(image == nullptr) {
+        return false;
+    }
+
+    SDL_BlendMode premultiplied_blend_mode = SDL_ComposeCustomBlendMode(
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+        SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+    if(SDL_SetTextureBlendMode(image->texture, premultiplied_blend_mode) != 0) {
+        std::cout << "Unable to set premultiplied blend mode for render target! SDL Error " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Everything drawn until the matching render_end_target goes into the target instead of whatever was being drawn to.
+// Targets nest, and commands queued before this call are flushed first so they still land where they were meant to
+void render_begin_target(ImageHandle target) {
+    Image* image = render_get_image(target);
+    if(image == nullptr) {
+        return;
+    }
+
+    render_flush();
+    render_stats.target_switches++;
+    render_target_stack.push_back((RenderTargetState) {
+        .target = target,
+        .layer = render_layer,
+        .sort_key = render_sort_key
+    });
+    SDL_SetRenderTarget(renderer, image->texture);
+}
+
+void render_end_target() {
+    if(render_target_stack.empty()) {
+        return;
+    }
+
+    render_flush();
+    render_stats.target_switches++;
+    RenderTargetState previous_state = render_target_stack.back();
+    render_target_stack.pop_back();
+    render_layer = previous_state.layer;
+    render_sort_key = previous_state.sort_key;
+
+    SDL_Texture* previous_texture = nullptr;
+    if(!render_target_stack.empty()) {
+        Image* previous_target = render_get_image(render_target_stack.back().target);
+        if(previous_target != nullptr) {
+            previous_texture = previous_target->texture;
+        }
+    }
+    SDL_SetRenderTarget(renderer, previous_texture);
+}
+
+// The area draws are culled against, which is the current target's size while drawing into one and the screen otherwise
+SDL_Rect render_get_viewport_rect() {
+    if(!render_target_stack.empty()) {
+        Image* target = render_get_image(render_target_stack.back().target);
+        if(target != nullptr) {
+            return (SDL_Rect) { .x = 0, .y = 0, .w = target->size.x, .h = target->size.y };
+        }
+    }
+    return (SDL_Rect) { .x = 0, .y = 0, .w = SCREEN_WIDTH, .h = SCREEN_HEIGHT };
+}
+
+// Clears whatever is currently being drawn to, which is the current target if there is one
+void render_clear_target(SDL_Color color) {
+    render_flush();
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    SDL_RenderClear(renderer);
+}
+
+// Frees the image's texture and bumps its slot's generation so that any handles still pointing at it read as stale
+void render_unload_image(ImageHandle handle) {
+    Image* image = render_get_image(handle);
+    if(image == nullptr) {
+        return;
+    }
+
+    // Anything still queued might be drawing with this texture
+    render_flush();
+
+    int slot_index = handle & IMAGE_HANDLE_INDEX_MASK;
+    ImageSlot& slot = image_slots[slot_index];
+    if(image->owns_texture && image->texture != nullptr) {
+        render_destroy_texture(image->texture);
+    }
+    image_registry.erase(slot.path);
+    slot.path = "";
+    slot.in_use = false;
+    slot.generation++;
+    free_image_slots.push_back(slot_index);
+}
+
+std::string render_get_path(ImageHandle handle) {
+    Image* image = render_get_image(handle);
+    if(image == nullptr) {
+        return "";
+    }
+
+    return image_slots[handle & IMAGE_HANDLE_INDEX_MASK].path;
+}
+
+vec2 render_get_frame_size(ImageHandle handle) {
+    Image* image = render_get_image(handle);
+    if(image == nullptr) {
+        return (vec2) { .x = 0, .y = 0 };
+    }
+
+    return image->frame_size;
 }
 
 // Rendering functions
 
+// Stats for the last frame that was presented
+RenderStats render_get_stats() {
+    return render_last_frame_stats;
+}
+
+// Textures currently alive, as opposed to the per-frame created and destroyed counts in the stats
+int render_get_texture_count() {
+    return render_texture_count;
+}
+
+void render_stats_overlay(vec2 position) {
+    static const int LINE_HEIGHT = 10;
+    char line[64];
+
+    snprintf(line, sizeof(line), "Draws: %d Binds: %d", render_last_frame_stats.draw_calls, render_last_frame_stats.texture_binds);
+    render_text(line, FONT_HACK, COLOR_YELLOW, position);
+    snprintf(line, sizeof(line), "Quads: %d Fill: %ldpx", render_last_frame_stats.quads, render_last_frame_stats.fill_area);
+    render_text(line, FONT_HACK, COLOR_YELLOW, (vec2) { .x = position.x, .y = position.y + LINE_HEIGHT });
+    snprintf(line, sizeof(line), "Tex: +%d -%d Text: %d Targets: %d", render_last_frame_stats.textures_created, render_last_frame_stats.textures_destroyed,
+        render_last_frame_stats.text_rasterizations, render_last_frame_stats.target_switches);
+    render_text(line, FONT_HACK, COLOR_YELLOW, (vec2) { .x = position.x, .y = position.y + (LINE_HEIGHT * 2) });
+    snprintf(line, sizeof(line), "Cache: %lu hit %lu miss %lu evict %d/%dKB", text_cache_stats.hits, text_cache_stats.misses,
+        text_cache_stats.evictions, text_cache_stats.bytes / 1024, text_cache_budget / 1024);
+    render_text(line, FONT_HACK, COLOR_YELLOW, (vec2) { .x = position.x, .y = position.y + (LINE_HEIGHT * 3) });
+}
+
+// How far between the previous and the latest simulation tick this frame is being drawn, from 0 to 1
+void render_set_interpolation(float alpha) {
+    render_interpolation = alpha;
+}
+
+float render_get_interpolation() {
+    return render_interpolation;
+}
+
+// Anything that changes what the next frame would look like marks it dirty. When nothing has,
+// the caller can skip rendering and presenting entirely and the window keeps showing the last frame
+void render_mark_dirty() {
+    render_frame_dirty = true;
+}
+
+bool render_is_dirty() {
+    return render_frame_dirty;
+}
+
 void render_clear() {
+    render_flush();
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
 }
 
 void render_present() {
+    TRACE_SCOPE("render_present");
+    render_flush();
     SDL_RenderPresent(renderer);
+    render_frame++;
+
+    render_last_frame_stats = render_stats;
+    render_stats = RenderStats();
+    render_bound_texture = nullptr;
+    render_frame_dirty = false;
+}
+
+// Command queue
+
+void render_set_layer(RenderLayer layer) {
+    render_layer = layer;
+    render_sort_key = 0;
+}
+
+void render_set_sort_key(int sort_key) {
+    render_sort_key = sort_key;
+}
+
+// Textures get small ids in the order they are first drawn so that they fit in the sort key
+uint32_t render_get_texture_id(SDL_Texture* texture) {
+    auto lookup = texture_ids.find(texture);
+    if(lookup != texture_ids.end()) {
+        return lookup->second;
+    }
+
+    uint32_t texture_id = next_texture_id & 0x0FFFFFFF;
+    next_texture_id++;
+    texture_ids[texture] = texture_id;
+    return texture_id;
+}
+
+// Packs a command into a 64 bit key: 4 bits of layer, then 32 bits of depth, then 28 bits of texture id.
+// Y-sorted layers use the biased sort key as the depth and group equal depths by texture,
+// other layers use the submission sequence as the depth so they keep the order they were drawn in
+uint64_t render_pack_sort_key(SDL_Texture* texture) {
+    uint64_t key = (uint64_t)render_layer << 60;
+    if(RENDER_LAYER_Y_SORTED[render_layer]) {
+        uint32_t depth = (uint32_t)((int64_t)render_sort_key + 0x80000000LL);
+        key |= (uint64_t)depth << 28;
+        key |= render_get_texture_id(texture) & 0x0FFFFFFF;
+    } else {
+        key |= (uint64_t)render_sequence << 28;
+    }
+    render_sequence++;
+
+    return key;
+}
+
+void render_submit_quad(SDL_Texture* texture, vec2 texture_size, const SDL_Rect& src_rect, const SDL_Rect& dst_rect, bool flipped, SDL_Color color) {
+    render_stats.quads++;
+    render_stats.fill_area += (long)dst_rect.w * dst_rect.h;
+    render_sort_entries.push_back((RenderSortEntry) {
+        .key = render_pack_sort_key(texture),
+        .command_index = (uint32_t)render_commands.size()
+    });
+    render_commands.push_back((RenderCommand) {
+        .texture = texture,
+        .texture_size = texture_size,
+        .src_rect = src_rect,
+        .dst_rect = dst_rect,
+        .flipped = flipped,
+        .color = color
+    });
+}
+
+// LSD radix sort over the 8 bytes of the key. It's stable, so commands with equal keys keep their submission order,
+// and passes where every key has the same byte are skipped, which is most of them for a typical frame
+void render_sort_commands() {
+    std::size_t count = render_sort_entries.size();
+    if(count == 0) {
+        return;
+    }
+    render_sort_scratch.resize(count);
+
+    RenderSortEntry* source = render_sort_entries.data();
+    RenderSortEntry* destination = render_sort_scratch.data();
+    for(int shift = 0; shift < 64; shift += 8) {
+        std::size_t offsets[256] = { 0 };
+        for(std::size_t i = 0; i < count; i++) {
+            offsets[(source[i].key >> shift) & 0xFF]++;
+        }
+        if(offsets[(source[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        std::size_t total = 0;
+        for(int bucket = 0; bucket < 256; bucket++) {
+            std::size_t bucket_count = offsets[bucket];
+            offsets[bucket] = total;
+            total += bucket_count;
+        }
+        for(std::size_t i = 0; i < count; i++) {
+            destination[offsets[(source[i].key >> shift) & 0xFF]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+
+    if(source != render_sort_entries.data()) {
+        std::copy(source, source + count, render_sort_entries.data());
+    }
+}
+
+// Sorts everything queued since the last flush, hands it to the batcher in order and draws it
+void render_flush() {
+    TRACE_SCOPE("render_flush");
+    if(!render_sort_entries.empty()) {
+        render_sort_commands();
+        for(const RenderSortEntry& entry : render_sort_entries) {
+            const RenderCommand& command = render_commands[entry.command_index];
+            render_batch_quad(command.texture, command.texture_size, command.src_rect, command.dst_rect, command.flipped, command.color);
+        }
+        render_sort_entries.clear();
+        render_commands.clear();
+    }
+    render_sequence = 0;
+
+    render_flush_batches();
+}
+
+// Batching
+
+// Appends a quad to the open batch for this texture. A new batch is only started when the texture changes,
+// so the draw order of the frame is preserved while runs of quads on one texture become a single draw call
+void render_batch_quad(SDL_Texture* texture, vec2 texture_size, const SDL_Rect& src_rect, const SDL_Rect& dst_rect, bool flipped, SDL_Color color) {
+    if(batch_count == 0 || batches[batch_count - 1].texture != texture) {
+        if(batch_count == batches.size()) {
+            batches.push_back(RenderBatch());
+        }
+        RenderBatch& new_batch = batches[batch_count];
+        new_batch.texture = texture;
+        new_batch.vertices.clear();
+        new_batch.indices.clear();
+        batch_count++;
+    }
+    RenderBatch& batch = batches[batch_count - 1];
+
+    float u0 = src_rect.x / (float)texture_size.x;
+    float v0 = src_rect.y / (float)texture_size.y;
+    float u1 = (src_rect.x + src_rect.w) / (float)texture_size.x;
+    float v1 = (src_rect.y + src_rect.h) / (float)texture_size.y;
+    if(flipped) {
+        std::swap(u0, u1);
+    }
+
+    float x0 = dst_rect.x;
+    float y0 = dst_rect.y;
+    float x1 = dst_rect.x + dst_rect.w;
+    float y1 = dst_rect.y + dst_rect.h;
+
+    int first_vertex = batch.vertices.size();
+    batch.vertices.push_back((SDL_Vertex) { .position = { x0, y0 }, .color = color, .tex_coord = { u0, v0 } });
+    batch.vertices.push_back((SDL_Vertex) { .position = { x1, y0 }, .color = color, .tex_coord = { u1, v0 } });
+    batch.vertices.push_back((SDL_Vertex) { .position = { x1, y1 }, .color = color, .tex_coord = { u1, v1 } });
+    batch.vertices.push_back((SDL_Vertex) { .position = { x0, y1 }, .color = color, .tex_coord = { u0, v1 } });
+
+    static const int QUAD_INDICES[6] = { 0, 1, 2, 0, 2, 3 };
+    for(int i = 0; i < 6; i++) {
+        batch.indices.push_back(first_vertex + QUAD_INDICES[i]);
+    }
+}
+
+void render_flush_batches() {
+    for(std::size_t i = 0; i < batch_count; i++) {
+        RenderBatch& batch = batches[i];
+        render_stats.draw_calls++;
+        if(batch.texture != render_bound_texture) {
+            render_stats.texture_binds++;
+            render_bound_texture = batch.texture;
+        }
+        if(SDL_RenderGeometry(renderer, batch.texture, batch.vertices.data(), batch.vertices.size(), batch.indices.data(), batch.indices.size()) != 0) {
+            std::cout << "Unable to render batch! SDL Error " << SDL_GetError() << std::endl;
+        }
+    }
+    batch_count = 0;
 }
 
 Image* render_create_text_image(const char* text, Font font, SDL_Color color) {
     SDL_Surface* text_surface = TTF_RenderText_Solid(fonts[font], text, color);
+    render_stats.text_rasterizations++;
     if(text_surface == nullptr) {
         std::cout << "Unable to render text to surface! SDL Error " << TTF_GetError() << std::endl;
         return nullptr;
     }
 
-    SDL_Texture* text_texture = SDL_CreateTextureFromSurface(renderer, text_surface);
+    SDL_Texture* text_texture = render_create_texture_from_surface(text_surface);
     if(text_texture == nullptr) {
         std::cout << "Unable to create text texture! SDL Error " << SDL_GetError() << std::endl;
         return nullptr;
@@ -119,63 +960,287 @@ Image* render_create_text_image(const char* text, Font font, SDL_Color color) {
     Image* text_image = new Image();
     text_image->texture = text_texture;
     text_image->size = (vec2){ .x = text_surface->w, .y = text_surface->h };
+    text_image->texture_size = text_image->size;
+    text_image->offset = (vec2) { .x = 0, .y = 0 };
     text_image->frame_size = (vec2) { .x = 0, .y = 0 };
+    text_image->owns_texture = true;
 
     SDL_FreeSurface(text_surface);
 
     return text_image;
 }
 
-void render_text(const char* text, Font font, SDL_Color color, vec2 position) {
-    Image* text_image = render_create_text_image(text, font, color);
+// Text cache
+
+void render_set_text_backend(TextBackend backend) {
+    text_backend = backend;
+}
 
-    SDL_Rect source_rect = (SDL_Rect){ .x = 0, .y = 0, .w = text_image->size.x, .h = text_image->size.y };
-    SDL_Rect dest_rect = (SDL_Rect){ .x = position.x, .y = position.y, .w = text_image->size.x, .h = text_image->size.y };
-    if(dest_rect.x == RENDER_POSITION_CENTERED) {
-        dest_rect.x = (SCREEN_WIDTH / 2) - (source_rect.w / 2);
+void render_set_text_cache_budget(int bytes) {
+    text_cache_budget = bytes;
+    render_trim_text_cache();
+}
+
+void render_clear_text_cache() {
+    for(TextCacheEntry& entry : text_cache) {
+        render_destroy_texture(entry.image->texture);
+        delete entry.image;
     }
-    if(dest_rect.y == RENDER_POSITION_CENTERED) {
-        dest_rect.y = (SCREEN_HEIGHT / 2) - (source_rect.h / 2);
+    text_cache.clear();
+    text_cache_lookup.clear();
+    text_cache_stats.entries = 0;
+    text_cache_stats.bytes = 0;
+}
+
+bool render_text_fits_atlas(const char* text, std::size_t length) {
+    for(std::size_t i = 0; i < length; i++) {
+        if(text[i] < GLYPH_FIRST || text[i] > GLYPH_LAST) {
+            return false;
+        }
     }
 
-    SDL_RenderCopy(renderer, text_image->texture, &source_rect, &dest_rect);
-    SDL_DestroyTexture(text_image->texture);
-    delete text_image;
+    return true;
 }
 
-void render_text_centered(const char* text, Font font, SDL_Color color, SDL_Rect rect) {
+// FNV-1a over the text, font and color so that lookups don't need to allocate a key string
+uint64_t render_hash_text_key(const char* text, Font font, SDL_Color color) {
+    uint64_t hash = 14695981039346656037ULL;
+    for(const char* c = text; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+    }
+    uint8_t suffix[5] = { (uint8_t)font, color.r, color.g, color.b, color.a };
+    for(int i = 0; i < 5; i++) {
+        hash = (hash ^ suffix[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+void render_trim_text_cache() {
+    // Walk from the least recently used end, but never evict an image that has been drawn this frame
+    while(text_cache_stats.bytes > text_cache_budget && !text_cache.empty()) {
+        TextCacheEntry& entry = text_cache.back();
+        if(entry.last_used_frame == render_frame) {
+            break;
+        }
+
+        text_cache_stats.bytes -= entry.bytes;
+        text_cache_stats.entries--;
+        text_cache_stats.evictions++;
+        render_destroy_texture(entry.image->texture);
+        delete entry.image;
+        text_cache_lookup.erase(entry.key);
+        text_cache.pop_back();
+    }
+}
+
+Image* render_get_text_image(const char* text, Font font, SDL_Color color) {
+    uint64_t key = render_hash_text_key(text, font, color);
+
+    auto lookup = text_cache_lookup.find(key);
+    if(lookup != text_cache_lookup.end()) {
+        TextCacheEntry& entry = *lookup->second;
+        bool entry_matches = entry.font == font && entry.text == text
+            && entry.color.r == color.r && entry.color.g == color.g && entry.color.b == color.b && entry.color.a == color.a;
+        if(entry_matches) {
+            text_cache_stats.hits++;
+            entry.last_used_frame = render_frame;
+            text_cache.splice(text_cache.begin(), text_cache, lookup->second);
+            return entry.image;
+        }
+
+        // Hash collision, so drop the old entry and let the new string take its key
+        // If the old image was drawn this frame its quads are still queued, so submit them before the texture goes away
+        if(entry.last_used_frame == render_frame) {
+            render_flush();
+        }
+        text_cache_stats.bytes -= entry.bytes;
+        text_cache_stats.entries--;
+        render_destroy_texture(entry.image->texture);
+        delete entry.image;
+        text_cache.erase(lookup->second);
+        text_cache_lookup.erase(lookup);
+    }
+
+    text_cache_stats.misses++;
     Image* text_image = render_create_text_image(text, font, color);
+    if(text_image == nullptr) {
+        return nullptr;
+    }
 
-    SDL_Rect source_rect = (SDL_Rect) { .x = 0, .y = 0, .w = text_image->size.x, .h = text_image->size.y };
-    SDL_Rect dst_rect = (SDL_Rect) {
-        .x = rect.x + (rect.w / 2) - (text_image->size.x / 2),
-        .y = rect.y + (rect.h / 2) - (text_image->size.y / 2),
-        .w = text_image->size.x,
-        .h = text_image->size.y };
+    TextCacheEntry new_entry = (TextCacheEntry) {
+        .key = key,
+        .text = text,
+        .font = font,
+        .color = color,
+        .image = text_image,
+        .bytes = text_image->size.x * text_image->size.y * 4,
+        .last_used_frame = render_frame
+    };
+    text_cache.push_front(new_entry);
+    text_cache_lookup[key] = text_cache.begin();
+    text_cache_stats.entries++;
+    text_cache_stats.bytes += new_entry.bytes;
+
+    render_trim_text_cache();
+
+    return text_image;
+}
+
+void render_text_cached(const char* text, Font font, SDL_Color color, vec2 position) {
+    Image* text_image = render_get_text_image(text, font, color);
+    if(text_image == nullptr) {
+        return;
+    }
+
+    render_text_image(text_image, position);
+}
+
+void render_text_image(Image* text_image, vec2 position) {
+    SDL_Rect dst_rect = (SDL_Rect) { .x = position.x, .y = position.y, .w = text_image->size.x, .h = text_image->size.y };
+    if(dst_rect.x == RENDER_POSITION_CENTERED) {
+        dst_rect.x = (SCREEN_WIDTH / 2) - (dst_rect.w / 2);
+    }
+    if(dst_rect.y == RENDER_POSITION_CENTERED) {
+        dst_rect.y = (SCREEN_HEIGHT / 2) - (dst_rect.h / 2);
+    }
+
+    SDL_Rect src_rect = (SDL_Rect) { .x = 0, .y = 0, .w = text_image->size.x, .h = text_image->size.y };
+    render_submit_quad(text_image->texture, text_image->texture_size, src_rect, dst_rect, false, COLOR_WHITE);
+}
+
+vec2 render_get_text_size(const char* text, Font font) {
+    return (vec2) { .x = render_get_text_width(text, strlen(text), font), .y = glyph_atlases[font].line_height };
+}
+
+// Text that render_text would send through the text cache is measured by TTF, whose kerning the glyph advances don't have
+int render_get_text_width(const char* text, std::size_t length, Font font) {
+    if(!render_text_uses_atlas(text, length)) {
+        char* terminated_text = render_terminate_text(text, length);
+        int width = 0;
+        if(terminated_text == nullptr || TTF_SizeText(fonts[font], terminated_text, &width, nullptr) != 0) {
+            return 0;
+        }
+        return width;
+    }
+
+    const GlyphAtlas& atlas = glyph_atlases[font];
+    int width = 0;
+    for(std::size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if(c < GLYPH_FIRST || c > GLYPH_LAST) {
+            continue;
+        }
+        width += atlas.glyphs[c - GLYPH_FIRST].advance;
+    }
+
+    return width;
+}
+
+void render_text(const char* text, Font font, SDL_Color color, vec2 position) {
+    render_text(text, strlen(text), font, color, position);
+}
+
+// The cache and TTF want terminated strings, so slices are copied into frame scratch memory instead of a temporary std::string
+char* render_terminate_text(const char* text, std::size_t length) {
+    char* terminated_text = (char*)scratch_alloc(length + 1);
+    if(terminated_text == nullptr) {
+        return nullptr;
+    }
+    memcpy(terminated_text, text, length);
+    terminated_text[length] = '\0';
+
+    return terminated_text;
+}
+
+// Whether render_text draws this text from the glyph atlas rather than the text cache
+bool render_text_uses_atlas(const char* text, std::size_t length) {
+    return text_backend == TEXT_BACKEND_GLYPH_ATLAS && render_text_fits_atlas(text, length);
+}
 
-    SDL_RenderCopy(renderer, text_image->texture, &source_rect, &dst_rect);
-    SDL_DestroyTexture(text_image->texture);
-    delete text_image;
+// Draws a slice of text through the text cache whatever the backend, for callers that need its metrics throughout
+void render_text_cached(const char* text, std::size_t length, Font font, SDL_Color color, vec2 position) {
+    char* terminated_text = render_terminate_text(text, length);
+    if(terminated_text == nullptr) {
+        return;
+    }
+    render_text_cached(terminated_text, font, color, position);
+}
+
+// Draws the first length characters of text, which lets callers draw a slice of a string without copying it
+void render_text(const char* text, std::size_t length, Font font, SDL_Color color, vec2 position) {
+    if(!render_text_uses_atlas(text, length)) {
+        render_text_cached(text, length, font, color, position);
+        return;
+    }
+
+    const GlyphAtlas& atlas = glyph_atlases[font];
+
+    if(position.x == RENDER_POSITION_CENTERED) {
+        position.x = (SCREEN_WIDTH / 2) - (render_get_text_width(text, length, font) / 2);
+    }
+    if(position.y == RENDER_POSITION_CENTERED) {
+        position.y = (SCREEN_HEIGHT / 2) - (atlas.line_height / 2);
+    }
+
+    // Solid text has never been alpha blended, so only take the color's rgb
+    SDL_Color glyph_color = (SDL_Color) { .r = color.r, .g = color.g, .b = color.b, .a = 255 };
+    for(std::size_t i = 0; i < length; i++) {
+        const Glyph& glyph = atlas.glyphs[text[i] - GLYPH_FIRST];
+        if(glyph.rect.w != 0) {
+            SDL_Rect dst_rect = (SDL_Rect) { .x = position.x, .y = position.y, .w = glyph.rect.w, .h = glyph.rect.h };
+            render_submit_quad(atlas.texture, atlas.size, glyph.rect, dst_rect, false, glyph_color);
+        }
+        position.x += glyph.advance;
+    }
 }
 
-void render_image(int image_index, vec2 position) {
+void render_text_centered(const char* text, Font font, SDL_Color color, SDL_Rect rect) {
+    if(!render_text_uses_atlas(text, strlen(text))) {
+        // Draw the image that was measured rather than looking the string up in the cache a second time
+        Image* text_image = render_get_text_image(text, font, color);
+        if(text_image == nullptr) {
+            return;
+        }
+        render_text_image(text_image, (vec2) {
+            .x = rect.x + (rect.w / 2) - (text_image->size.x / 2),
+            .y = rect.y + (rect.h / 2) - (text_image->size.y / 2) });
+        return;
+    }
+
+    vec2 text_size = render_get_text_size(text, font);
+    render_text(text, font, color, (vec2) {
+        .x = rect.x + (rect.w / 2) - (text_size.x / 2),
+        .y = rect.y + (rect.h / 2) - (text_size.y / 2) });
+}
+
+void render_image(ImageHandle handle, vec2 position) {
+    Image* image = render_get_image(handle);
+    if(image == nullptr || image->texture == nullptr) {
+        return;
+    }
+
     SDL_Rect dst_rect = (SDL_Rect) {
         .x = position.x,
         .y = position.y,
-        .w = images[image_index].size.x,
-        .h = images[image_index].size.y,
+        .w = image->size.x,
+        .h = image->size.y,
     };
 
-    SDL_Rect screen_rect = (SDL_Rect) { .x = 0, .y = 0, .w = SCREEN_WIDTH, .h = SCREEN_HEIGHT };
-    if(!rects_intersect(dst_rect, screen_rect)) {
+    if(!rects_intersect(dst_rect, render_get_viewport_rect())) {
         return;
     }
 
-    SDL_RenderCopy(renderer, images[image_index].texture, NULL, &dst_rect);
+    SDL_Rect src_rect = (SDL_Rect) { .x = image->offset.x, .y = image->offset.y, .w = image->size.x, .h = image->size.y };
+    render_submit_quad(image->texture, image->texture_size, src_rect, dst_rect, false, COLOR_WHITE);
 }
 
-void render_image_frame(int image_index, vec2 frame, vec2 position, bool flipped) {
-    Image& image = images[image_index];
+void render_image_frame(ImageHandle handle, vec2 frame, vec2 position, bool flipped) {
+    Image* image_pointer = render_get_image(handle);
+    if(image_pointer == nullptr || image_pointer->texture == nullptr) {
+        return;
+    }
+    const Image& image = *image_pointer;
 
     SDL_Rect src_rect = (SDL_Rect) {
         .x = frame.x * image.frame_size.x,
@@ -192,43 +1257,71 @@ void render_image_frame(int image_index, vec2 frame, vec2 position, bool flipped
 
     if(src_rect.x < 0 || src_rect.x > image.size.x - image.frame_size.x
         || src_rect.y < 0 || src_rect.y > image.size.y - image.frame_size.y) {
-        std::cout << "Index (" << frame.x << ", " << frame.y << ") out of bounds for image with path " << image_paths[image_index] << std::endl;
+        std::cout << "Index (" << frame.x << ", " << frame.y << ") out of bounds for image with path " << render_get_path(handle) << std::endl;
         return;
     }
 
-    SDL_Rect screen_rect = (SDL_Rect) { .x = 0, .y = 0, .w = SCREEN_WIDTH, .h = SCREEN_HEIGHT };
-    if(!rects_intersect(dst_rect, screen_rect)) {
+    if(!rects_intersect(dst_rect, render_get_viewport_rect())) {
         return;
     }
 
-    SDL_RendererFlip render_flip = SDL_FLIP_NONE;
-    if(flipped) {
-        render_flip = SDL_FLIP_HORIZONTAL;
+    src_rect.x += image.offset.x;
+    src_rect.y += image.offset.y;
+    render_submit_quad(image.texture, image.texture_size, src_rect, dst_rect, flipped, COLOR_WHITE);
+}
+
+// Draws a source rect that's already known to be inside the image, such as a precomputed animation frame
+void render_image_rect(ImageHandle handle, const SDL_Rect& src_rect, vec2 position, bool flipped) {
+    Image* image = render_get_image(handle);
+    if(image == nullptr || image->texture == nullptr) {
+        return;
     }
 
-    SDL_RenderCopyEx(renderer, image.texture, &src_rect, &dst_rect, 0, NULL, render_flip);
+    SDL_Rect dst_rect = (SDL_Rect) { .x = position.x, .y = position.y, .w = src_rect.w, .h = src_rect.h };
+    if(!rects_intersect(dst_rect, render_get_viewport_rect())) {
+        return;
+    }
+
+    SDL_Rect texture_rect = (SDL_Rect) { .x = image->offset.x + src_rect.x, .y = image->offset.y + src_rect.y, .w = src_rect.w, .h = src_rect.h };
+    render_submit_quad(image->texture, image->texture_size, texture_rect, dst_rect, flipped, COLOR_WHITE);
 }
 
-void render_image_frame_stretched(int image_index, vec2 frame, SDL_Rect dst_rect) {
-    Image& image = images[dialog_box_image];
+void render_image_frame_stretched(ImageHandle handle, vec2 frame, SDL_Rect dst_rect) {
+    Image* image_pointer = render_get_image(handle);
+    if(image_pointer == nullptr || image_pointer->texture == nullptr) {
+        return;
+    }
+    const Image& image = *image_pointer;
 
     SDL_Rect src_rect = (SDL_Rect) {
-        .x = frame.x * image.frame_size.x,
-        .y = frame.y * image.frame_size.y,
+        .x = image.offset.x + (frame.x * image.frame_size.x),
+        .y = image.offset.y + (frame.y * image.frame_size.y),
         .w = image.frame_size.x,
         .h = image.frame_size.y,
     };
 
-    SDL_Rect screen_rect = (SDL_Rect) { .x = 0, .y = 0, .w = SCREEN_WIDTH, .h = SCREEN_HEIGHT };
-    if(!rects_intersect(dst_rect, screen_rect)) {
+    if(!rects_intersect(dst_rect, render_get_viewport_rect())) {
+        return;
+    }
+
+    render_submit_quad(image.texture, image.texture_size, src_rect, dst_rect, false, COLOR_WHITE);
+}
+
+// Solid rects are quads of the white pixel texture, so they batch with everything else instead of needing their own draw calls
+void render_fill_rect(SDL_Rect dst_rect, SDL_Color color) {
+    if(white_texture == nullptr || !rects_intersect(dst_rect, render_get_viewport_rect())) {
         return;
     }
 
-    SDL_RenderCopy(renderer, image.texture, &src_rect, &dst_rect);
+    render_submit_quad(white_texture, (vec2) { .x = 1, .y = 1 }, (SDL_Rect) { .x = 0, .y = 0, .w = 1, .h = 1 }, dst_rect, false, color);
 }
 
 void render_dialog_box(SDL_Rect dst_rect) {
-    Image& image = images[dialog_box_image];
+    Image* image_pointer = render_get_image(dialog_box_image);
+    if(image_pointer == nullptr) {
+        return;
+    }
+    const Image& image = *image_pointer;
 
     render_image_frame(dialog_box_image,  // top left corner
             (vec2) { .x = 0, .y = 0 },
@@ -21,27 +21,126 @@ typedef enum Font {
     FONT_COUNT
 } Font;
 
+// Layers are drawn in this order. Within a y-sorted layer commands are ordered by their sort key,
+// within the other layers they are drawn in the order they were submitted
+typedef enum RenderLayer {
+    RENDER_LAYER_BACKGROUND,
+    RENDER_LAYER_WORLD,
+    RENDER_LAYER_FOREGROUND,
+    RENDER_LAYER_UI,
+    RENDER_LAYER_OVERLAY,
+    RENDER_LAYER_COUNT
+} RenderLayer;
+
+typedef enum TextBackend {
+    TEXT_BACKEND_GLYPH_ATLAS,
+    TEXT_BACKEND_TEXT_CACHE
+} TextBackend;
+
+// Counters for one frame of rendering, everything between two presents
+typedef struct RenderStats {
+    int draw_calls;
+    int texture_binds;
+    int quads;
+    long fill_area; // Destination pixels covered by quads, counting overdraw
+    int textures_created;
+    int textures_destroyed;
+    int text_rasterizations;
+    int target_switches;
+} RenderStats;
+
+typedef struct TextCacheStats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    int entries;
+    int bytes;
+} TextCacheStats;
+
+// Handles to registered images. The low bits index the image's registry slot and the bits above them hold
+// the slot's generation, which changes whenever the slot is unloaded, so stale handles can be detected
+typedef int ImageHandle;
+const ImageHandle IMAGE_HANDLE_NONE = -1;
+const int IMAGE_HANDLE_INDEX_BITS = 16;
+const int IMAGE_HANDLE_INDEX_MASK = (1 << IMAGE_HANDLE_INDEX_BITS) - 1;
+const int IMAGE_HANDLE_GENERATION_MASK = 0x7FFF;
+
 typedef struct Image {
     SDL_Texture* texture;
+    vec2 texture_size;
+    vec2 offset; // Position of the image within its texture, non-zero when it lives on an atlas page
     vec2 size;
     vec2 frame_size;
+    bool owns_texture;
 } Image;
 
 // Resource initialization
 bool render_load_resources();
 void render_free_resources();
 void render_load_font(Font font, std::string path, int size);
-int render_load_image(std::string path);
-int render_load_spritesheet(std::string path, vec2 frame_size);
-std::string render_get_path(int image_index);
-vec2 render_get_frame_size(int image_index);
+bool render_build_glyph_atlas(Font font);
+bool render_load_atlas(std::string manifest_path);
+void render_unload_atlas();
+SDL_Texture* render_create_texture_from_surface(SDL_Surface* surface);
+void render_destroy_texture(SDL_Texture* texture);
+ImageHandle render_load_image(std::string path);
+ImageHandle render_load_spritesheet(std::string path, vec2 frame_size);
+ImageHandle render_load_image_async(std::string path);
+ImageHandle render_load_spritesheet_async(std::string path, vec2 frame_size);
+bool render_image_is_loaded(ImageHandle handle);
+bool render_update_image_loads();
+bool render_finish_image_loads();
+void render_unload_image(ImageHandle handle);
+ImageHandle render_create_target(vec2 size);
+bool render_set_target_premultiplied(ImageHandle target);
+void render_begin_target(ImageHandle target);
+void render_end_target();
+void render_clear_target(SDL_Color color);
+SDL_Rect render_get_viewport_rect();
+bool render_image_handle_valid(ImageHandle handle);
+Image* render_get_image(ImageHandle handle);
+std::string render_get_path(ImageHandle handle);
+vec2 render_get_frame_size(ImageHandle handle);
 
 // Render functions
+RenderStats render_get_stats();
+int render_get_texture_count();
+void render_stats_overlay(vec2 position);
+void render_set_interpolation(float alpha);
+float render_get_interpolation();
+void render_mark_dirty();
+bool render_is_dirty();
 void render_clear();
 void render_present();
+void render_set_layer(RenderLayer layer);
+void render_set_sort_key(int sort_key);
+void render_submit_quad(SDL_Texture* texture, vec2 texture_size, const SDL_Rect& src_rect, const SDL_Rect& dst_rect, bool flipped, SDL_Color color);
+void render_sort_commands();
+void render_flush();
+void render_batch_quad(SDL_Texture* texture, vec2 texture_size, const SDL_Rect& src_rect, const SDL_Rect& dst_rect, bool flipped, SDL_Color color);
+void render_flush_batches();
 Image* render_create_text_image(const char* text, Font font, SDL_Color color);
+vec2 render_get_text_size(const char* text, Font font);
+int render_get_text_width(const char* text, std::size_t length, Font font);
+bool render_text_fits_atlas(const char* text, std::size_t length);
+bool render_text_uses_atlas(const char* text, std::size_t length);
+char* render_terminate_text(const char* text, std::size_t length);
+
+// Text cache
+void render_set_text_backend(TextBackend backend);
+void render_set_text_cache_budget(int bytes);
+void render_clear_text_cache();
+void render_trim_text_cache();
+Image* render_get_text_image(const char* text, Font font, SDL_Color color);
+void render_text_cached(const char* text, Font font, SDL_Color color, vec2 position);
+void render_text_cached(const char* text, std::size_t length, Font font, SDL_Color color, vec2 position);
+void render_text_image(Image* text_image, vec2 position);
 void render_text(const char* text, Font font, SDL_Color color, vec2 position);
+void render_text(const char* text, std::size_t length, Font font, SDL_Color color, vec2 position);
 void render_text_centered(const char* text, Font font, SDL_Color color, SDL_Rect rect);
-void render_image(int image_index, vec2 position);
-void render_image_frame(int image_index, vec2 frame, vec2 position, bool flipped);
+void render_image(ImageHandle handle, vec2 position);
+void render_image_frame(ImageHandle handle, vec2 frame, vec2 position, bool flipped);
+void render_image_rect(ImageHandle handle, const SDL_Rect& src_rect, vec2 position, bool flipped);
+void render_image_frame_stretched(ImageHandle handle, vec2 frame, SDL_Rect dst_rect);
+void render_fill_rect(SDL_Rect dst_rect, SDL_Color color);
 void render_dialog_box(SDL_Rect dst_rect);
@@ -3,21 +3,35 @@
 #include "render.hpp"
 #include "pause.hpp"
 #include "json.hpp"
+#include "trace.hpp"
+#include "flight_recorder.hpp"
+#include "frame_stats.hpp"
+#include "profiler_overlay.hpp"
+#include "spatial_grid.hpp"
+#include "spatial_tree.hpp"
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <fstream>
 
 using nlohmann::json;
 
 const float DIALOG_CHAR_SPEED = 0.05;
-const int ROW_CHAR_LENGTH = 37;
+const int DIALOG_ROW_COUNT = 3;
+const Font DIALOG_FONT = FONT_HELVETICA;
 const int DIALOG_BOX_HEIGHT = 50;
 const int DIALOG_LINE_HEIGHT = 14;
 const vec2 DIALOG_PADDING = (vec2) { .x = 10, .y = 2 };
 const vec2 EVIDENCE_PROMPT_SIZE = (vec2) { .x = 60, .y = 60 };
+const int COLLISION_GRID_CELL_SIZE = 64;
+// Actors can move, or switch to a clip with a different frame size, after the actor grid is built for the tick,
+// so queries against it look this much further out and then test each candidate's current rect
+const int ACTOR_GRID_SLACK = 16;
 
 // Init
 
 Scene::Scene(std::string path) {
+    TRACE_SCOPE("Scene::Scene");
     // Load scene file
     std::ifstream map_file;
     map_file.open(path);
@@ -28,13 +42,35 @@ Scene::Scene(std::string path) {
     json map_json = json::parse(map_file);
     map_file.close();
 
-    // Load map background image
-    background_image = render_load_image(map_json["background"].get<std::string>());
+    // Load map background, either a single image or a chunk manifest to stream from
+    background.load(map_json["background"].get<std::string>());
     map_size = (vec2) {
         .x = map_json["map_size"][0].get<int>(),
         .y = map_json["map_size"][1].get<int>(),
     };
 
+    // Load parallax layers, drawn behind the actors unless marked as foreground
+    if(map_json.contains("layers")) {
+        for(json layer_json : map_json["layers"]) {
+            vec2 layer_position = (vec2) { .x = 0, .y = 0 };
+            if(layer_json.contains("position")) {
+                layer_position = (vec2) {
+                    .x = layer_json["position"][0].get<int>(),
+                    .y = layer_json["position"][1].get<int>()
+                };
+            }
+            float scroll_x = 1.0f;
+            float scroll_y = 1.0f;
+            if(layer_json.contains("scroll")) {
+                scroll_x = layer_json["scroll"][0].get<float>();
+                scroll_y = layer_json["scroll"][1].get<float>();
+            }
+            bool foreground = layer_json.contains("foreground") && layer_json["foreground"].get<bool>();
+            background_layers.add_layer(layer_json["image"].get<std::string>(), layer_position, scroll_x, scroll_y,
+                foreground ? BACKGROUND_PLANE_FRONT : BACKGROUND_PLANE_BACK);
+        }
+    }
+
     // Load colliders
     for(json collider_array : map_json["colliders"]) {
         SDL_Rect collider = (SDL_Rect) {
@@ -45,6 +81,7 @@ Scene::Scene(std::string path) {
         };
         colliders.push_back(collider);
     }
+    spatial_grid_init(actor_grid, map_size, COLLISION_GRID_CELL_SIZE);
 
     // Load scenery
     for(json scenery_json : map_json["scenery"]) {
@@ -75,6 +112,14 @@ Scene::Scene(std::string path) {
         scenery.push_back(new_scenery);
     }
 
+    // Index the colliders and then the scenery together, so collision, interaction and anything else that asks about
+    // the static parts of the map share one tree. Items below colliders.size() are colliders, the rest are scenery
+    std::vector<SDL_Rect> static_rects = colliders;
+    for(const Scenery& scenery_item : scenery) {
+        static_rects.push_back(scenery_item.collider);
+    }
+    spatial_tree_build(static_tree, static_rects.data(), static_rects.size());
+
 
     // Load actors
     for(json actor_json : map_json["actors"]) {
@@ -107,6 +152,7 @@ Scene::Scene(std::string path) {
             }
         }
 
+        new_actor.previous_position = new_actor.position;
         actors.push_back(new_actor);
     }
 
@@ -167,6 +213,8 @@ Scene::Scene(std::string path) {
 
     // Init UI
     init_ui_rects();
+    dialog_text_target = render_create_target((vec2) { .x = DIALOG_BOX_RECT.w, .y = DIALOG_BOX_RECT.h });
+    dialog_text_drawn = 0;
 
     // Init evidence dialog box
     evidence_dialog = Menu(EVIDENCE_PROMPT_RECT);
@@ -181,8 +229,11 @@ Scene::Scene(std::string path) {
     }
     player_direction = (vec2) { .x = 0, .y = 0 };
     camera_offset = (vec2) { .x = 0, .y = 0 };
+    previous_camera_offset = camera_offset;
     dialog_open = false;
     current_script = -1;
+    last_render_state_hash = 0;
+    rebuild_actor_grid();
 }
 
 void Scene::init_ui_rects() {
@@ -320,18 +371,52 @@ void Scene::progress_dialog() {
             actor_being_spoken_to = -1;
         } else {
             dialog_index = 1;
+            dialog_text_drawn = 0;
         }
     }
 }
 
 void Scene::open_dialog(const std::vector<DialogLine>& dialog_lines) {
     dialog_queue.clear();
-    for(DialogLine dialog_line : dialog_lines) {
-        dialog_queue.push_back(dialog_line);
+    for(const DialogLine& dialog_line : dialog_lines) {
+        queue_dialog_line(dialog_line);
     }
     dialog_index = 1;
     dialog_index_timer = DIALOG_CHAR_SPEED;
     dialog_open = true;
+    dialog_text_drawn = 0;
+    flight_recorder_event("dialog opened", dialog_queue.empty() ? "" : dialog_queue[0].text.c_str());
+}
+
+void Scene::queue_dialog_line(const DialogLine& dialog_line) {
+    dialog_queue.push_back(dialog_line);
+    layout_dialog_line(dialog_queue.back());
+}
+
+// Word wraps the line once using the dialog font's real widths, measured with whichever text backend will draw each row,
+// so rendering only has to slice the text
+void Scene::layout_dialog_line(DialogLine& dialog_line) const {
+    const std::string& text = dialog_line.text;
+    int row_width = DIALOG_BOX_RECT.w - (DIALOG_PADDING.x * 2);
+
+    dialog_line.row_starts.clear();
+    dialog_line.row_starts.push_back(0);
+
+    std::size_t row_start = 0;
+    std::size_t word_start = 0;
+    for(std::size_t i = 0; i <= text.length(); i++) {
+        if(i != text.length() && text[i] != ' ') {
+            continue;
+        }
+
+        // If the word that ends here doesn't fit on the row, it starts the next one and the space before it is dropped
+        bool word_overflows = render_get_text_width(text.c_str() + row_start, i - row_start, DIALOG_FONT) > row_width;
+        if(word_overflows && word_start > row_start) {
+            row_start = word_start;
+            dialog_line.row_starts.push_back(row_start);
+        }
+        word_start = i + 1;
+    }
 }
 
 // Evidence
@@ -349,22 +434,88 @@ void Scene::evidence_dialog_handle_select() {
     evidence_dialog_open = false;
 }
 
+// Called once per fixed simulation tick, so delta is always the tick length
 void Scene::update(float delta) {
+    TRACE_SCOPE("Scene::update");
+    // Keep where everything was at the end of the last tick, which is what rendering interpolates from
+    for(Actor& actor : actors) {
+        actor.previous_position = actor.position;
+    }
+    previous_camera_offset = camera_offset;
+
+    frame_stats_begin_phase(FRAME_PHASE_PLAYER);
     player_handle_input(delta);
 
+    frame_stats_begin_phase(FRAME_PHASE_SCRIPTS);
     if(current_script != -1) {
         script_execute(current_script, delta);
     }
 
-    for(int i = 0; i < actors.size(); i++) {
-        if(actor_being_spoken_to == i) {
-            actors[i].set_direction_towards(actors[actor_player].position);
-        } else {
-            actor_update(i, delta);
+    frame_stats_begin_phase(FRAME_PHASE_ACTORS);
+    rebuild_actor_grid();
+
+    // Each actor moves and then resolves its collisions before the next one moves, so the two can't be timed apart
+    // without switching phases per actor. The whole loop counts as collision instead
+    {
+        TRACE_SCOPE("collision");
+        frame_stats_begin_phase(FRAME_PHASE_COLLISION);
+        for(int i = 0; i < actors.size(); i++) {
+            if(actor_being_spoken_to == i) {
+                actors[i].set_direction_towards(actors[actor_player].position);
+            } else {
+                actor_update(i, delta);
+            }
         }
     }
 
+    frame_stats_begin_phase(FRAME_PHASE_ACTORS);
+    for(Actor& actor : actors) {
+        animation_advance(actor.animation, delta);
+    }
+
+    frame_stats_begin_phase(FRAME_PHASE_CAMERA);
     camera_update(delta);
+    background.update(camera_offset);
+    frame_stats_begin_phase(FRAME_PHASE_UPDATE);
+    profiler_overlay_set_scene_counts(actors.size(), colliders.size(), dialog_open ? dialog_queue.size() : 0);
+
+    interpolating = camera_offset != previous_camera_offset;
+    for(const Actor& actor : actors) {
+        interpolating = interpolating || actor.position != actor.previous_position;
+    }
+
+    uint64_t render_state_hash = hash_render_state();
+    if(render_state_hash != last_render_state_hash) {
+        last_render_state_hash = render_state_hash;
+        render_mark_dirty();
+    }
+}
+
+// Hashes everything Scene::render reads that can change during update, so that an idle scene can skip rendering
+uint64_t Scene::hash_render_state() const {
+    uint64_t hash = 14695981039346656037ULL;
+    auto hash_int = [&hash](int64_t value) {
+        hash = (hash ^ (uint64_t)value) * 1099511628211ULL;
+    };
+
+    hash_int(camera_offset.x);
+    hash_int(camera_offset.y);
+    hash_int(previous_camera_offset.x);
+    hash_int(previous_camera_offset.y);
+    for(const Actor& actor : actors) {
+        hash_int(actor.position.x);
+        hash_int(actor.position.y);
+        hash_int(actor.previous_position.x);
+        hash_int(actor.previous_position.y);
+        hash_int(actor.animation.clip);
+        hash_int(actor.animation.frame);
+    }
+    hash_int(dialog_open);
+    hash_int(dialog_queue.size());
+    hash_int(dialog_open ? dialog_index : 0);
+    hash_int(evidence_dialog_open);
+
+    return hash;
 }
 
 // Player
@@ -410,32 +561,25 @@ void Scene::player_interact() {
             break;
     }
 
-    for(int i = 0; i < actors.size(); i++) {
-        if(i == actor_player) {
-            continue;
-        }
-
-        if(rects_intersect(interact_scan_rect, actors[i].get_rect())) {
-            open_dialog(actors[i].dialog);
-            dialog_left_profile_index = actors[actor_player].image_profile_index;
-            dialog_right_profile_index = actors[i].image_profile_index;
-            actor_being_spoken_to = i;
-            return;
-        }
+    int i = get_first_actor_overlap(interact_scan_rect, actor_player);
+    if(i != -1) {
+        open_dialog(actors[i].dialog);
+        dialog_left_profile_index = actors[actor_player].image_profile_index;
+        dialog_right_profile_index = actors[i].image_profile_index;
+        actor_being_spoken_to = i;
+        return;
     }
 
-    for(int i = 0; i < scenery.size(); i++) {
-        if(rects_intersect(interact_scan_rect, scenery[i].collider)) {
-            open_dialog(scenery[i].description);
-            dialog_queue.push_back((DialogLine) {
-                .speaker = "",
-                .text = "Would you like to add " + scenery[i].name + " to the evidence log?"
-            });
-            dialog_left_profile_index = -1;
-            dialog_right_profile_index = -1;
-            evidence_dialog_evidence_name = scenery[i].name;
-            return;
-        }
+    i = get_first_static_overlap(interact_scan_rect, colliders.size(), colliders.size() + scenery.size());
+    if(i != -1) {
+        open_dialog(scenery[i].description);
+        queue_dialog_line((DialogLine) {
+            .speaker = "",
+            .text = "Would you like to add " + scenery[i].name + " to the evidence log?"
+        });
+        dialog_left_profile_index = IMAGE_HANDLE_NONE;
+        dialog_right_profile_index = IMAGE_HANDLE_NONE;
+        evidence_dialog_evidence_name = scenery[i].name;
     }
 }
 
@@ -484,28 +628,69 @@ void Scene::actor_update(int actor_index, float delta) {
     actor.update(delta);
 
     SDL_Rect actor_rect = actor.get_rect();
-    for(SDL_Rect collider : colliders) {
-        if(rects_intersect(actor_rect, collider)) {
-            actor.handle_collision(collider);
-            break;
-        }
+
+    // Of the colliders that overlap, the one that comes first in the map is collided with
+    int hit_collider = get_first_static_overlap(actor_rect, 0, colliders.size());
+    if(hit_collider != -1) {
+        actor.handle_collision(colliders[hit_collider]);
+    }
+
+    int hit_actor = get_first_actor_overlap(actor_rect, actor_index);
+    if(hit_actor != -1) {
+        actor.handle_collision(actors[hit_actor].get_rect());
+    }
+}
+
+// Spatial queries
+
+void Scene::rebuild_actor_grid() {
+    actor_rects.resize(actors.size());
+    for(int i = 0; i < actors.size(); i++) {
+        actor_rects[i] = actors[i].get_rect();
     }
+    spatial_grid_build(actor_grid, actor_rects.data(), actor_rects.size());
+}
 
-    for(int j = 0; j < actors.size(); j++) {
-        if(actor_index == j) {
+// The lowest indexed actor other than ignored_actor that overlaps the rect, or -1
+int Scene::get_first_actor_overlap(const SDL_Rect& rect, int ignored_actor) {
+    SDL_Rect search_rect = (SDL_Rect) {
+        .x = rect.x - ACTOR_GRID_SLACK,
+        .y = rect.y - ACTOR_GRID_SLACK,
+        .w = rect.w + (ACTOR_GRID_SLACK * 2),
+        .h = rect.h + (ACTOR_GRID_SLACK * 2)
+    };
+    spatial_query_results.clear();
+    spatial_grid_query(actor_grid, search_rect, spatial_query_results);
+
+    int first_actor = -1;
+    for(int candidate : spatial_query_results) {
+        if(candidate == ignored_actor) {
             continue;
         }
+        if((first_actor == -1 || candidate < first_actor) && rects_intersect(rect, actors[candidate].get_rect())) {
+            first_actor = candidate;
+        }
+    }
+    return first_actor;
+}
 
-        if(rects_intersect(actor_rect, actors[j].get_rect())) {
-            actor.handle_collision(actors[j].get_rect());
-            break;
+// The lowest static tree item in [first_item, end_item) that overlaps the rect, relative to first_item, or -1
+int Scene::get_first_static_overlap(const SDL_Rect& rect, int first_item, int end_item) {
+    spatial_query_results.clear();
+    spatial_tree_query_rect(static_tree, rect, spatial_query_results);
+
+    int first_overlap = -1;
+    for(int item : spatial_query_results) {
+        if(item >= first_item && item < end_item && (first_overlap == -1 || item < first_overlap)) {
+            first_overlap = item;
         }
     }
+    return first_overlap == -1 ? -1 : first_overlap - first_item;
 }
 
 // Scripts
 
-int Scene::get_actor_from_name(std::string name) {
+int Scene::get_actor_from_name(const std::string& name) const {
     for(int i = 0; i < actors.size(); i++) {
         if(name == actors[i].name) {
             return i;
@@ -525,24 +710,33 @@ void Scene::script_begin(int script_index) {
     scripts[script_index].current_line = 0;
     scripts[script_index].playing = true;
 
-    for(std::string required_actor : scripts[script_index].required_actors) {
+    for(const std::string& required_actor : scripts[script_index].required_actors) {
         actors[get_actor_from_name(required_actor)].in_scene = true;
     }
 
     current_script = script_index;
+
+    char detail[32];
+    snprintf(detail, sizeof(detail), "script %d", script_index);
+    flight_recorder_event("script started", detail);
 }
 
 void Scene::script_finish(int script_index) {
     scripts[script_index].playing = false;
 
-    for(std::string required_actor : scripts[script_index].required_actors) {
+    for(const std::string& required_actor : scripts[script_index].required_actors) {
         actors[get_actor_from_name(required_actor)].in_scene = false;
     }
 
     current_script = -1;
+
+    char detail[32];
+    snprintf(detail, sizeof(detail), "script %d", script_index);
+    flight_recorder_event("script finished", detail);
 }
 
 void Scene::script_execute(int script_index, float delta) {
+    TRACE_SCOPE("Scene::script_execute");
     Script& script = scripts.at(script_index);
     if(script.current_line == script.lines.size()) {
         script_finish(script_index);
@@ -587,75 +781,109 @@ void Scene::script_execute(int script_index, float delta) {
 
     script.current_line++;
 
+    char detail[48];
+    snprintf(detail, sizeof(detail), "script %d line %d", script_index, script.current_line);
+    flight_recorder_event("script line advanced", detail);
+
     script_execute(script_index, delta);
 }
 
 void Scene::render() {
-    render_image(background_image, camera_offset.inverse());
-    for(Actor actor : actors) {
-        actor.render(camera_offset);
+    TRACE_SCOPE("Scene::render");
+    animation_check_loaded_clips();
+    // Bring the dialog text and layer composite targets up to date before anything is queued for the screen, so switching targets doesn't split the frame's batches
+    if(dialog_open) {
+        render_dialog_text(dialog_queue[0], dialog_index);
+    }
+    vec2 render_camera_offset = vec2_lerp(previous_camera_offset, camera_offset, render_get_interpolation());
+    background_layers.compose(render_camera_offset);
+
+    render_set_layer(RENDER_LAYER_BACKGROUND);
+    background.render(render_camera_offset);
+    background_layers.render(BACKGROUND_PLANE_BACK, render_camera_offset);
+
+    render_set_layer(RENDER_LAYER_WORLD);
+    for(const Actor& actor : actors) {
+        actor.render(render_camera_offset);
     }
+
+    render_set_layer(RENDER_LAYER_FOREGROUND);
+    background_layers.render(BACKGROUND_PLANE_FRONT, render_camera_offset);
+
+    render_set_layer(RENDER_LAYER_UI);
     if(dialog_open) {
-        render_dialog(dialog_queue[0].speaker, dialog_queue[0].text, dialog_index);
+        render_dialog(dialog_queue[0], dialog_index);
     }
     if(evidence_dialog_open) {
         evidence_dialog.render();
     }
 }
 
-void Scene::render_dialog(std::string speaker, std::string text, std::size_t dialog_index) {
-    if(dialog_left_profile_index != -1) {
+void Scene::render_dialog(const DialogLine& dialog_line, std::size_t dialog_index) {
+    if(dialog_left_profile_index != IMAGE_HANDLE_NONE) {
         vec2 profile_frame_size = render_get_frame_size(dialog_left_profile_index);
         render_image(dialog_left_profile_index, (vec2) { .x = 0, .y = DIALOG_BOX_RECT.y - profile_frame_size.y });
     }
-    if(dialog_right_profile_index != -1) {
+    if(dialog_right_profile_index != IMAGE_HANDLE_NONE) {
         vec2 profile_frame_size = render_get_frame_size(dialog_right_profile_index);
         render_image_frame(dialog_right_profile_index, (vec2) { .x = 0, .y = 0 }, (vec2) { .x = SCREEN_WIDTH - profile_frame_size.x, .y = DIALOG_BOX_RECT.y - profile_frame_size.y }, true);
     }
 
-    std::string rows[3];
+    render_dialog_box(DIALOG_BOX_RECT);
+    render_image(dialog_text_target, (vec2) { .x = DIALOG_BOX_RECT.x, .y = DIALOG_BOX_RECT.y });
 
-    int row_index = 0;
-    std::size_t copy_index = 0;
-    while(row_index != 3 && copy_index <= dialog_index) {
-        // Add the next character
-        rows[row_index].push_back(text[copy_index]);
-        copy_index++;
+    if(dialog_line.speaker.length() != 0) {
+        render_dialog_box(SPEAKER_BOX_RECT);
+        render_text_centered(dialog_line.speaker.c_str(), DIALOG_FONT, COLOR_BLACK, SPEAKER_TEXT_CENTER_RECT);
+    }
+}
 
-        // If we've reached the end of the word...
-        if(text[copy_index] == ' ') {
-            // ...find the length of the next word
-            std::size_t next_space_index = text.substr(copy_index + 1).find(" ");
-            std::size_t next_word_length;
-            if(next_space_index == std::string::npos) {
-                next_word_length = text.substr(copy_index + 1).length();
-            } else {
-                next_word_length = text.substr(copy_index + 1, next_space_index).length();
-            }
+// Both the dialog text and the layer composites are drawn incrementally, so start them over from scratch
+void Scene::invalidate_render_targets() {
+    dialog_text_drawn = 0;
+    background_layers.invalidate();
+}
 
-            // If it's too long for this row, handle the space as a new line. Otherwise count it as a space
-            if(rows[row_index].length() + next_word_length + 1 > ROW_CHAR_LENGTH) {
-                row_index++;
-            } else {
-                rows[row_index].push_back(' ');
-            }
-            // And since we've already added a space, move up the copy_index so that we don't add the space
-            copy_index++;
-        }
+// The dialog text lives in a target texture that persists between frames, and only the characters revealed
+// since the last frame are drawn into it. The target is cleared whenever a new line starts typing
+void Scene::render_dialog_text(const DialogLine& dialog_line, std::size_t dialog_index) {
+    if(dialog_index <= dialog_text_drawn) {
+        return;
     }
 
-    render_dialog_box(DIALOG_BOX_RECT);
-    for(int i = 0; i < 3; i++) {
-        if(rows[i].length() == 0) {
+    render_begin_target(dialog_text_target);
+    if(dialog_text_drawn == 0) {
+        render_clear_target(COLOR_BLACK);
+    }
+    render_set_layer(RENDER_LAYER_UI);
+
+    const std::string& text = dialog_line.text;
+    std::size_t row_count = std::min(dialog_line.row_starts.size(), (std::size_t)DIALOG_ROW_COUNT);
+    for(std::size_t i = 0; i < row_count; i++) {
+        std::size_t row_start = dialog_line.row_starts[i];
+        std::size_t row_end = i + 1 < dialog_line.row_starts.size() ? dialog_line.row_starts[i + 1] - 1 : text.length();
+
+        // Only the part of this row between what's already drawn and what's now revealed
+        std::size_t segment_start = std::max(row_start, dialog_text_drawn);
+        std::size_t segment_end = std::min(row_end, dialog_index);
+        if(segment_end <= segment_start) {
             continue;
         }
-        render_text(rows[i].c_str(), FONT_HELVETICA, COLOR_BLACK,
-            (vec2) {
-            .x = DIALOG_BOX_RECT.x + DIALOG_PADDING.x,
-            .y = DIALOG_BOX_RECT.y + DIALOG_PADDING.y + (DIALOG_LINE_HEIGHT * i) });
-    }
-    if(speaker.length() != 0) {
-        render_dialog_box(SPEAKER_BOX_RECT);
-        render_text_centered(speaker.c_str(), FONT_HELVETICA, COLOR_BLACK, SPEAKER_TEXT_CENTER_RECT);
+
+        // Rows the atlas can't draw go through the text cache, whose kerning means a slice isn't drawn where the
+        // atlas advances would put it. Those rows are drawn whole from their start each time instead, which lands
+        // every earlier character exactly where it was drawn last time
+        vec2 row_position = (vec2) { .x = DIALOG_PADDING.x, .y = DIALOG_PADDING.y + (DIALOG_LINE_HEIGHT * (int)i) };
+        if(!render_text_uses_atlas(text.c_str() + row_start, row_end - row_start)) {
+            render_text_cached(text.c_str() + row_start, segment_end - row_start, DIALOG_FONT, COLOR_BLACK, row_position);
+            continue;
+        }
+
+        int segment_x = render_get_text_width(text.c_str() + row_start, segment_start - row_start, DIALOG_FONT);
+        render_text(text.c_str() + segment_start, segment_end - segment_start, DIALOG_FONT, COLOR_BLACK,
+            (vec2) { .x = row_position.x + segment_x, .y = row_position.y });
     }
+
+    render_end_target();
+    dialog_text_drawn = dialog_index;
 }
@@ -5,9 +5,13 @@
 #include "vector.hpp"
 #include "inventory.hpp"
 #include "menu.hpp"
+#include "background.hpp"
+#include "spatial_grid.hpp"
+#include "spatial_tree.hpp"
 #include <SDL2/SDL.h>
 #include <vector>
 #include <string>
+#include <cstdint>
 
 class Scene : public IState {
     public:
@@ -69,17 +73,24 @@ class Scene : public IState {
         void handle_input(SDL_Event e);
         void update(float delta);
         void render();
+        void invalidate_render_targets();
 
     private:
         // Init
         void init_ui_rects();
 
+        // Render state
+        uint64_t hash_render_state() const;
+
+        uint64_t last_render_state_hash;
+
         SDL_Rect DIALOG_BOX_RECT;
         SDL_Rect SPEAKER_BOX_RECT;
         SDL_Rect SPEAKER_TEXT_CENTER_RECT;
         SDL_Rect EVIDENCE_PROMPT_RECT;
 
-        int background_image;
+        Background background;
+        BackgroundLayers background_layers;
         vec2 map_size;
         std::vector<SDL_Rect> colliders;
         std::vector<Scenery> scenery;
@@ -101,6 +112,7 @@ class Scene : public IState {
         void camera_update(float delta);
 
         vec2 camera_offset;
+        vec2 previous_camera_offset;
 
         // Actors
         void actor_update(int actor_index, float delta);
@@ -109,8 +121,18 @@ class Scene : public IState {
         int actor_player;
         int actor_being_spoken_to;
 
+        // Spatial queries
+        void rebuild_actor_grid();
+        int get_first_actor_overlap(const SDL_Rect& rect, int ignored_actor);
+        int get_first_static_overlap(const SDL_Rect& rect, int first_item, int end_item);
+
+        SpatialTree static_tree; // Colliders followed by scenery colliders, built once at load
+        SpatialGrid actor_grid; // Rebuilt every tick from actor_rects
+        std::vector<SDL_Rect> actor_rects;
+        std::vector<int> spatial_query_results;
+
         // Scripts
-        int get_actor_from_name(std::string name);
+        int get_actor_from_name(const std::string& name) const;
         void script_begin(int script_index);
         void script_finish(int script_index);
         void script_execute(int script_index, float delta);
@@ -120,15 +142,20 @@ class Scene : public IState {
 
         // Dialog
         void open_dialog(const std::vector<DialogLine>& dialog_lines);
+        void queue_dialog_line(const DialogLine& dialog_line);
+        void layout_dialog_line(DialogLine& dialog_line) const;
         void progress_dialog();
-        void render_dialog(std::string speaker, std::string text, std::size_t dialog_index);
+        void render_dialog(const DialogLine& dialog_line, std::size_t dialog_index);
+        void render_dialog_text(const DialogLine& dialog_line, std::size_t dialog_index);
 
         std::vector<DialogLine> dialog_queue;
         std::size_t dialog_index;
         float dialog_index_timer;
         bool dialog_open;
-        int dialog_left_profile_index;
-        int dialog_right_profile_index;
+        ImageHandle dialog_left_profile_index;
+        ImageHandle dialog_right_profile_index;
+        ImageHandle dialog_text_target;
+        std::size_t dialog_text_drawn;
 
         // Evidence
         void evidence_dialog_handle_select();
@@ -0,0 +1,64 @@
+#include "scratch.hpp"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+const std::size_t SCRATCH_ALIGNMENT = 16;
+
+char* scratch_buffer = nullptr;
+std::size_t scratch_capacity = 0;
+std::size_t scratch_offset = 0;
+
+bool scratch_init(std::size_t capacity) {
+    scratch_buffer = (char*)malloc(capacity);
+    if(scratch_buffer == nullptr) {
+        std::cout << "Unable to allocate " << capacity << " bytes of frame scratch memory!" << std::endl;
+        return false;
+    }
+    scratch_capacity = capacity;
+    scratch_offset = 0;
+    return true;
+}
+
+void scratch_quit() {
+    free(scratch_buffer);
+    scratch_buffer = nullptr;
+    scratch_capacity = 0;
+    scratch_offset = 0;
+}
+
+void scratch_reset() {
+    scratch_offset = 0;
+}
+
+// Returns nullptr once the frame's scratch memory runs out rather than falling back to the heap
+void* scratch_alloc(std::size_t size) {
+    std::size_t aligned_offset = (scratch_offset + SCRATCH_ALIGNMENT - 1) & ~(SCRATCH_ALIGNMENT - 1);
+    if(scratch_buffer == nullptr || aligned_offset + size > scratch_capacity) {
+        std::cout << "Frame scratch memory exhausted! Requested " << size << " bytes" << std::endl;
+        return nullptr;
+    }
+    scratch_offset = aligned_offset + size;
+    return scratch_buffer + aligned_offset;
+}
+
+// printf into scratch memory. Returns an empty string if there wasn't room
+const char* scratch_format(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list measure_args;
+    va_copy(measure_args, args);
+    int length = vsnprintf(nullptr, 0, format, measure_args);
+    va_end(measure_args);
+
+    char* text = length < 0 ? nullptr : (char*)scratch_alloc(length + 1);
+    if(text == nullptr) {
+        va_end(args);
+        return "";
+    }
+    vsnprintf(text, length + 1, format, args);
+    va_end(args);
+    return text;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+// Linear allocator for strings and buffers that only need to live until the end of the current frame.
+// Allocating just bumps an offset into a block reserved at startup, and the whole block is released at once by
+// scratch_reset at the top of every frame, so transient formatting never touches the heap
+bool scratch_init(std::size_t capacity);
+void scratch_quit();
+void scratch_reset();
+void* scratch_alloc(std::size_t size);
+const char* scratch_format(const char* format, ...);
@@ -0,0 +1,86 @@
+#include "spatial_grid.hpp"
+
+#include <algorithm>
+
+void spatial_grid_init(SpatialGrid& grid, vec2 area_size, int cell_size) {
+    grid.cell_size = cell_size;
+    grid.columns = std::max((area_size.x + cell_size - 1) / cell_size, 1);
+    grid.rows = std::max((area_size.y + cell_size - 1) / cell_size, 1);
+    grid.cell_starts.assign((grid.columns * grid.rows) + 1, 0);
+    grid.cell_items.clear();
+    grid.item_query_stamps.clear();
+    grid.query_stamp = 0;
+}
+
+// Cells covered by a rect. Anything outside the grid's area is clamped onto its edge cells
+static void spatial_grid_get_cell_range(const SpatialGrid& grid, const SDL_Rect& rect, int& first_column, int& first_row, int& last_column, int& last_row) {
+    first_column = std::clamp(rect.x / grid.cell_size, 0, grid.columns - 1);
+    first_row = std::clamp(rect.y / grid.cell_size, 0, grid.rows - 1);
+    last_column = std::clamp((rect.x + std::max(rect.w, 1) - 1) / grid.cell_size, 0, grid.columns - 1);
+    last_row = std::clamp((rect.y + std::max(rect.h, 1) - 1) / grid.cell_size, 0, grid.rows - 1);
+}
+
+// Counting sort the rects into their cells, first counting how many land in each cell and then filling them in
+void spatial_grid_build(SpatialGrid& grid, const SDL_Rect* rects, int rect_count) {
+    int cell_count = grid.columns * grid.rows;
+    std::fill(grid.cell_starts.begin(), grid.cell_starts.end(), 0);
+
+    int first_column, first_row, last_column, last_row;
+    for(int i = 0; i < rect_count; i++) {
+        spatial_grid_get_cell_range(grid, rects[i], first_column, first_row, last_column, last_row);
+        for(int row = first_row; row <= last_row; row++) {
+            for(int column = first_column; column <= last_column; column++) {
+                grid.cell_starts[(row * grid.columns) + column + 1]++;
+            }
+        }
+    }
+    for(int cell = 0; cell < cell_count; cell++) {
+        grid.cell_starts[cell + 1] += grid.cell_starts[cell];
+    }
+
+    // Shift the starts up by one so that cell_starts[cell + 1] can be the cell's write cursor. Once every item is
+    // written each cursor has reached the start of the following cell, which puts cell_starts back the way it should be
+    grid.cell_items.resize(grid.cell_starts[cell_count]);
+    for(int cell = cell_count; cell > 0; cell--) {
+        grid.cell_starts[cell] = grid.cell_starts[cell - 1];
+    }
+    for(int i = 0; i < rect_count; i++) {
+        spatial_grid_get_cell_range(grid, rects[i], first_column, first_row, last_column, last_row);
+        for(int row = first_row; row <= last_row; row++) {
+            for(int column = first_column; column <= last_column; column++) {
+                int cell = (row * grid.columns) + column;
+                grid.cell_items[grid.cell_starts[cell + 1]] = i;
+                grid.cell_starts[cell + 1]++;
+            }
+        }
+    }
+
+    if((int)grid.item_query_stamps.size() < rect_count) {
+        grid.item_query_stamps.resize(rect_count, 0);
+    }
+}
+
+// Appends every item in the cells the rect covers to results, each at most once. These are only candidates,
+// the caller still has to test them against the rect
+void spatial_grid_query(SpatialGrid& grid, const SDL_Rect& rect, std::vector<int>& results) {
+    grid.query_stamp++;
+    if(grid.query_stamp == 0) {
+        std::fill(grid.item_query_stamps.begin(), grid.item_query_stamps.end(), 0);
+        grid.query_stamp = 1;
+    }
+
+    int first_column, first_row, last_column, last_row;
+    spatial_grid_get_cell_range(grid, rect, first_column, first_row, last_column, last_row);
+    for(int row = first_row; row <= last_row; row++) {
+        for(int column = first_column; column <= last_column; column++) {
+            int cell = (row * grid.columns) + column;
+            for(int i = grid.cell_starts[cell]; i < grid.cell_starts[cell + 1]; i++) {
+                int item = grid.cell_items[i];
+                if(grid.item_query_stamps[item] != grid.query_stamp) {
+                    grid.item_query_stamps[item] = grid.query_stamp;
+                    results.push_back(item);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "vector.hpp"
+#include <SDL2/SDL.h>
+#include <vector>
+
+// Uniform grid over a map, used as a broadphase so that collision only tests the rects in nearby cells.
+// Items are indices into whatever array of rects the grid was built from. Cells are stored flattened, with
+// each cell's items in one shared array, so rebuilding every tick reuses the same memory once it's grown
+typedef struct SpatialGrid {
+    int cell_size;
+    int columns;
+    int rows;
+    std::vector<int> cell_starts; // Cell i's items are cell_items[cell_starts[i]] up to cell_items[cell_starts[i + 1]]
+    std::vector<int> cell_items;
+    std::vector<unsigned int> item_query_stamps; // So items spanning several cells are only returned once per query
+    unsigned int query_stamp;
+} SpatialGrid;
+
+void spatial_grid_init(SpatialGrid& grid, vec2 area_size, int cell_size);
+void spatial_grid_build(SpatialGrid& grid, const SDL_Rect* rects, int rect_count);
+void spatial_grid_query(SpatialGrid& grid, const SDL_Rect& rect, std::vector<int>& results);
@@ -0,0 +1,192 @@
+#include "spatial_tree.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+const int SPATIAL_TREE_LEAF_SIZE = 4;
+
+static SDL_Rect spatial_tree_union(const SDL_Rect& a, const SDL_Rect& b) {
+    int left = std::min(a.x, b.x);
+    int top = std::min(a.y, b.y);
+    int right = std::max(a.x + a.w, b.x + b.w);
+    int bottom = std::max(a.y + a.h, b.y + b.h);
+    return (SDL_Rect) { .x = left, .y = top, .w = right - left, .h = bottom - top };
+}
+
+// Splits the items at the median of whichever axis their centers are most spread out along, until they fit in a leaf
+static int spatial_tree_build_node(SpatialTree& tree, int first_item, int item_count) {
+    int node_index = tree.nodes.size();
+    tree.nodes.push_back((SpatialTreeNode) { .bounds = tree.item_rects[tree.items[first_item]], .left = -1, .right = -1, .first_item = first_item, .item_count = item_count });
+
+    int min_center_x = INT_MAX, max_center_x = INT_MIN, min_center_y = INT_MAX, max_center_y = INT_MIN;
+    SDL_Rect bounds = tree.item_rects[tree.items[first_item]];
+    for(int i = first_item; i < first_item + item_count; i++) {
+        const SDL_Rect& rect = tree.item_rects[tree.items[i]];
+        bounds = spatial_tree_union(bounds, rect);
+        min_center_x = std::min(min_center_x, rect.x + (rect.w / 2));
+        max_center_x = std::max(max_center_x, rect.x + (rect.w / 2));
+        min_center_y = std::min(min_center_y, rect.y + (rect.h / 2));
+        max_center_y = std::max(max_center_y, rect.y + (rect.h / 2));
+    }
+    tree.nodes[node_index].bounds = bounds;
+    if(item_count <= SPATIAL_TREE_LEAF_SIZE) {
+        return node_index;
+    }
+
+    bool split_x = max_center_x - min_center_x >= max_center_y - min_center_y;
+    const std::vector<SDL_Rect>& item_rects = tree.item_rects;
+    auto center_less = [&item_rects, split_x](int a, int b) {
+        const SDL_Rect& rect_a = item_rects[a];
+        const SDL_Rect& rect_b = item_rects[b];
+        return split_x ? rect_a.x * 2 + rect_a.w < rect_b.x * 2 + rect_b.w : rect_a.y * 2 + rect_a.h < rect_b.y * 2 + rect_b.h;
+    };
+    int half = item_count / 2;
+    std::nth_element(tree.items.begin() + first_item, tree.items.begin() + first_item + half, tree.items.begin() + first_item + item_count, center_less);
+
+    // Children are built before being linked since building them can reallocate the node array
+    int left = spatial_tree_build_node(tree, first_item, half);
+    int right = spatial_tree_build_node(tree, first_item + half, item_count - half);
+    tree.nodes[node_index].left = left;
+    tree.nodes[node_index].right = right;
+    tree.nodes[node_index].item_count = 0;
+    return node_index;
+}
+
+void spatial_tree_build(SpatialTree& tree, const SDL_Rect* rects, int rect_count) {
+    tree.nodes.clear();
+    tree.items.resize(rect_count);
+    tree.item_rects.assign(rects, rects + rect_count);
+    for(int i = 0; i < rect_count; i++) {
+        tree.items[i] = i;
+    }
+    if(rect_count != 0) {
+        spatial_tree_build_node(tree, 0, rect_count);
+    }
+}
+
+// Appends every item whose rect overlaps the given one
+void spatial_tree_query_rect(SpatialTree& tree, const SDL_Rect& rect, std::vector<int>& results) {
+    if(tree.nodes.empty()) {
+        return;
+    }
+
+    tree.node_stack.clear();
+    tree.node_stack.push_back(0);
+    while(!tree.node_stack.empty()) {
+        const SpatialTreeNode& node = tree.nodes[tree.node_stack.back()];
+        tree.node_stack.pop_back();
+        if(!rects_intersect(node.bounds, rect)) {
+            continue;
+        }
+
+        if(node.left != -1) {
+            tree.node_stack.push_back(node.left);
+            tree.node_stack.push_back(node.right);
+            continue;
+        }
+        for(int i = node.first_item; i < node.first_item + node.item_count; i++) {
+            if(rects_intersect(tree.item_rects[tree.items[i]], rect)) {
+                results.push_back(tree.items[i]);
+            }
+        }
+    }
+}
+
+// Appends every item whose rect contains the point, edges included
+void spatial_tree_query_point(SpatialTree& tree, vec2 point, std::vector<int>& results) {
+    if(tree.nodes.empty()) {
+        return;
+    }
+
+    tree.node_stack.clear();
+    tree.node_stack.push_back(0);
+    while(!tree.node_stack.empty()) {
+        const SpatialTreeNode& node = tree.nodes[tree.node_stack.back()];
+        tree.node_stack.pop_back();
+        if(!vec2_in_rect(point, node.bounds)) {
+            continue;
+        }
+
+        if(node.left != -1) {
+            tree.node_stack.push_back(node.left);
+            tree.node_stack.push_back(node.right);
+            continue;
+        }
+        for(int i = node.first_item; i < node.first_item + node.item_count; i++) {
+            if(vec2_in_rect(point, tree.item_rects[tree.items[i]])) {
+                results.push_back(tree.items[i]);
+            }
+        }
+    }
+}
+
+// Distance along the ray to where it enters the rect, or a negative number if it misses it within max_distance
+static float spatial_tree_ray_rect(const SDL_Rect& rect, vec2 origin, float direction_x, float direction_y, float max_distance) {
+    float enter = 0.0f;
+    float exit = max_distance;
+
+    float origins[2] = { (float)origin.x, (float)origin.y };
+    float directions[2] = { direction_x, direction_y };
+    float mins[2] = { (float)rect.x, (float)rect.y };
+    float maxes[2] = { (float)(rect.x + rect.w), (float)(rect.y + rect.h) };
+    for(int axis = 0; axis < 2; axis++) {
+        if(directions[axis] == 0.0f) {
+            if(origins[axis] < mins[axis] || origins[axis] > maxes[axis]) {
+                return -1.0f;
+            }
+            continue;
+        }
+
+        float near = (mins[axis] - origins[axis]) / directions[axis];
+        float far = (maxes[axis] - origins[axis]) / directions[axis];
+        if(near > far) {
+            std::swap(near, far);
+        }
+        enter = std::max(enter, near);
+        exit = std::min(exit, far);
+        if(enter > exit) {
+            return -1.0f;
+        }
+    }
+
+    return enter;
+}
+
+// Finds the first item hit by a ray, which is -1 if nothing is hit within max_distance. The direction doesn't need
+// to be normalized, but distances are measured in multiples of its length
+int spatial_tree_raycast(SpatialTree& tree, vec2 origin, float direction_x, float direction_y, float max_distance, float* hit_distance) {
+    int hit_item = -1;
+    float nearest = max_distance;
+    if(tree.nodes.empty()) {
+        return hit_item;
+    }
+
+    tree.node_stack.clear();
+    tree.node_stack.push_back(0);
+    while(!tree.node_stack.empty()) {
+        const SpatialTreeNode& node = tree.nodes[tree.node_stack.back()];
+        tree.node_stack.pop_back();
+        if(spatial_tree_ray_rect(node.bounds, origin, direction_x, direction_y, nearest) < 0.0f) {
+            continue;
+        }
+
+        if(node.left != -1) {
+            tree.node_stack.push_back(node.left);
+            tree.node_stack.push_back(node.right);
+            continue;
+        }
+        for(int i = node.first_item; i < node.first_item + node.item_count; i++) {
+            float distance = spatial_tree_ray_rect(tree.item_rects[tree.items[i]], origin, direction_x, direction_y, nearest);
+            if(distance >= 0.0f && (hit_item == -1 || distance < nearest || (distance == nearest && tree.items[i] < hit_item))) {
+                hit_item = tree.items[i];
+                nearest = distance;
+            }
+        }
+    }
+
+    if(hit_item != -1 && hit_distance != nullptr) {
+        *hit_distance = nearest;
+    }
+    return hit_item;
+}
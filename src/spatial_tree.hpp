@@ -0,0 +1,27 @@
+#pragma once
+
+#include "vector.hpp"
+#include <SDL2/SDL.h>
+#include <vector>
+
+// Bounding volume hierarchy over rects that don't move, built once when a scene loads. Items are indices into the
+// array of rects it was built from. Unlike the spatial grid's candidates, query results are exact
+typedef struct SpatialTreeNode {
+    SDL_Rect bounds;
+    int left;  // Child node indices, or -1 for leaves
+    int right;
+    int first_item; // Leaves hold items[first_item] up to items[first_item + item_count]
+    int item_count;
+} SpatialTreeNode;
+
+typedef struct SpatialTree {
+    std::vector<SpatialTreeNode> nodes;
+    std::vector<int> items;
+    std::vector<SDL_Rect> item_rects;
+    std::vector<int> node_stack; // Reused by queries so that they don't allocate
+} SpatialTree;
+
+void spatial_tree_build(SpatialTree& tree, const SDL_Rect* rects, int rect_count);
+void spatial_tree_query_rect(SpatialTree& tree, const SDL_Rect& rect, std::vector<int>& results);
+void spatial_tree_query_point(SpatialTree& tree, vec2 point, std::vector<int>& results);
+int spatial_tree_raycast(SpatialTree& tree, vec2 origin, float direction_x, float direction_y, float max_distance, float* hit_distance);
@@ -7,12 +7,16 @@ class IState {
         IState() {
             finished = false;
             render_previous = false;
+            interpolating = false;
             new_state = nullptr;
         }
         virtual void handle_input(SDL_Event e) = 0;
         virtual void update(float delta) = 0;
         virtual void render() = 0;
+        virtual void invalidate_render_targets() { } // Called when the renderer loses the contents of its targets
         bool finished;
         bool render_previous;
+        bool interpolating; // Set while the last simulation tick moved something, so frames between ticks look different
+
         IState* new_state;
 };
@@ -0,0 +1,130 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+typedef struct TraceEvent {
+    const char* name;
+    double start_us;
+    double duration_us;
+} TraceEvent;
+
+// Only the owning thread writes to a buffer. It publishes each event by bumping the write count, and readers
+// copy out the events and then check the count again to throw away any that were overwritten while copying
+const uint64_t TRACE_BUFFER_CAPACITY = 1 << 16;
+
+typedef struct TraceBuffer {
+    int thread_id;
+    const char* thread_name;
+    TraceEvent events[TRACE_BUFFER_CAPACITY];
+    std::atomic<uint64_t> write_count;
+} TraceBuffer;
+
+// Buffers are registered under a lock the first time a thread records anything, and never freed, since a trace
+// can still be written after the thread that filled the buffer has exited
+std::mutex trace_buffers_mutex;
+std::vector<TraceBuffer*> trace_buffers;
+thread_local TraceBuffer* trace_thread_buffer = nullptr;
+const std::chrono::steady_clock::time_point trace_start_time = std::chrono::steady_clock::now();
+
+TraceBuffer* trace_get_thread_buffer() {
+    if(trace_thread_buffer == nullptr) {
+        TraceBuffer* buffer = new TraceBuffer();
+        buffer->thread_name = nullptr;
+        buffer->write_count.store(0);
+
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+        buffer->thread_id = trace_buffers.size();
+        trace_buffers.push_back(buffer);
+        trace_thread_buffer = buffer;
+    }
+    return trace_thread_buffer;
+}
+
+TraceScope::TraceScope(const char* name) {
+    this->name = name;
+    start_us = trace_now_us();
+}
+
+TraceScope::~TraceScope() {
+    trace_record(name, start_us, trace_now_us() - start_us);
+}
+
+double trace_now_us() {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - trace_start_time).count();
+}
+
+void trace_record(const char* name, double start_us, double duration_us) {
+    TraceBuffer* buffer = trace_get_thread_buffer();
+    uint64_t write_count = buffer->write_count.load(std::memory_order_relaxed);
+    buffer->events[write_count % TRACE_BUFFER_CAPACITY] = (TraceEvent) {
+        .name = name,
+        .start_us = start_us,
+        .duration_us = duration_us
+    };
+    buffer->write_count.store(write_count + 1, std::memory_order_release);
+}
+
+void trace_set_thread_name(const char* name) {
+    trace_get_thread_buffer()->thread_name = name;
+}
+
+// Writes the most recent events from every thread as complete ("X") events in the Chrome trace-event format
+bool trace_write(std::string path) {
+#ifndef ENABLE_TRACING
+    std::cout << "Tracing isn't enabled in this build, build with make debug to record traces" << std::endl;
+    return false;
+#endif
+
+    FILE* file = fopen(path.c_str(), "w");
+    if(file == nullptr) {
+        std::cout << "Unable to open trace file " << path << "!" << std::endl;
+        return false;
+    }
+
+    std::vector<TraceBuffer*> buffers;
+    {
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+        buffers = trace_buffers;
+    }
+
+    std::vector<TraceEvent> events;
+    bool first_event = true;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(TraceBuffer* buffer : buffers) {
+        if(buffer->thread_name != nullptr) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first_event ? "" : ",\n", buffer->thread_id, buffer->thread_name);
+            first_event = false;
+        }
+
+        uint64_t end = buffer->write_count.load(std::memory_order_acquire);
+        uint64_t begin = end > TRACE_BUFFER_CAPACITY ? end - TRACE_BUFFER_CAPACITY : 0;
+        events.clear();
+        for(uint64_t i = begin; i < end; i++) {
+            events.push_back(buffer->events[i % TRACE_BUFFER_CAPACITY]);
+        }
+
+        // Anything the owning thread wrapped around onto while we were copying is torn, so skip it. That includes
+        // the slot for event end_after_copy, which may have been half written when the count was read
+        uint64_t end_after_copy = buffer->write_count.load(std::memory_order_acquire);
+        uint64_t first_intact = end_after_copy + 1 > TRACE_BUFFER_CAPACITY ? end_after_copy + 1 - TRACE_BUFFER_CAPACITY : 0;
+        for(uint64_t i = std::max(begin, first_intact); i < end; i++) {
+            const TraceEvent& event = events[i - begin];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first_event ? "" : ",\n", event.name, buffer->thread_id, event.start_us, event.duration_us);
+            first_event = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    fclose(file);
+    std::cout << "Wrote trace to " << path << std::endl;
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+// Scoped trace markers that can be written out as a Chrome trace-event file and opened in chrome://tracing or Perfetto.
+// Each thread records into its own fixed-size ring buffer, so recording never takes a lock. The markers compile to
+// nothing unless ENABLE_TRACING is defined, which the makefile's debug build does. Names must be string literals
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) trace_set_thread_name(name)
+#else
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+#endif
+
+class TraceScope {
+    public:
+        TraceScope(const char* name);
+        ~TraceScope();
+    private:
+        const char* name;
+        double start_us;
+};
+
+double trace_now_us();
+void trace_record(const char* name, double start_us, double duration_us);
+void trace_set_thread_name(const char* name);
+bool trace_write(std::string path);
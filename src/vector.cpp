@@ -1,5 +1,7 @@
 #include "vector.hpp"
 
+#include <cmath>
+
 bool rects_intersect(const SDL_Rect& a, const SDL_Rect& b) {
     return !(a.x + a.w <= b.x ||
              b.x + b.w <= a.x ||
@@ -10,3 +12,11 @@ bool rects_intersect(const SDL_Rect& a, const SDL_Rect& b) {
 bool vec2_in_rect(const vec2& v, const SDL_Rect& r) {
     return v.x >= r.x && v.x <= r.x + r.w && v.y >= r.y && v.y <= r.y + r.h;
 }
+
+// Rounds rather than truncates so that movement in either direction is interpolated the same way
+vec2 vec2_lerp(const vec2& from, const vec2& to, float t) {
+    return (vec2) {
+        .x = from.x + (int)lroundf((to.x - from.x) * t),
+        .y = from.y + (int)lroundf((to.y - from.y) * t)
+    };
+}
@@ -54,3 +54,4 @@ inline std::ostream& operator<<(std::ostream& os, const vec2& v) {
 
 bool rects_intersect(const SDL_Rect& a, const SDL_Rect& b);
 bool vec2_in_rect(const vec2& v, const SDL_Rect& r);
+vec2 vec2_lerp(const vec2& from, const vec2& to, float t);
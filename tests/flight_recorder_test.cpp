@@ -0,0 +1,77 @@
+// Checks that the flight recorder holds a frame's work against the budget, so frames that are long only because
+// the pacer held them to the target rate don't write recordings while a frame that really overruns does
+//
+// Usage: flight_recorder_test
+
+#include "flight_recorder.hpp"
+#include "frame_stats.hpp"
+#include "pacer.hpp"
+#include <SDL2/SDL.h>
+#include <filesystem>
+#include <iostream>
+
+const int TEST_FRAME_RATE = 30;
+const int TEST_IDLE_FRAMES = 5;
+
+int test_failures = 0;
+
+void test_expect(bool condition, const char* message) {
+    if(!condition) {
+        std::cout << "FAILED: " << message << std::endl;
+        test_failures++;
+    }
+}
+
+void test_busy_wait(double seconds) {
+    double end_time = pacer_now() + seconds;
+    while(pacer_now() < end_time) {
+    }
+}
+
+// Runs one frame that does work_seconds of work and is then paced like the main loop paces it
+void test_run_frame(double work_seconds) {
+    frame_stats_begin_phase(FRAME_PHASE_UPDATE);
+    test_busy_wait(work_seconds);
+    frame_stats_end_phase();
+    pacer_wait(true);
+}
+
+int main(int argc, char** argv) {
+    if(SDL_Init(SDL_INIT_TIMER) < 0) {
+        std::cout << "Unable to initialize SDL! SDL Error: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "flight_recorder_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    flight_recorder_set_directory(directory.string());
+
+    pacer_init(TEST_FRAME_RATE);
+    pacer_set_vsync(false, 0);
+    test_expect(flight_recorder_get_budget() < 1000.0 / TEST_FRAME_RATE + 10.0 && flight_recorder_get_budget() > 1000.0 / TEST_FRAME_RATE,
+        "the default budget follows the pacer's frame duration");
+
+    // Each of these frames takes the full 33ms, nearly all of it in the pacer
+    for(int i = 0; i < TEST_IDLE_FRAMES; i++) {
+        frame_stats_begin_frame();
+        test_expect(!flight_recorder_check_frame(), "a paced idle frame doesn't write a recording");
+        test_run_frame(0.001);
+    }
+
+    frame_stats_begin_frame();
+    test_expect(!flight_recorder_check_frame(), "a paced idle frame doesn't write a recording");
+    test_run_frame(flight_recorder_get_budget() / 1000.0 + 0.01);
+    frame_stats_begin_frame();
+    test_expect(flight_recorder_check_frame(), "a frame whose work goes over budget writes a recording");
+
+    std::filesystem::remove_all(directory);
+    SDL_Quit();
+
+    if(test_failures != 0) {
+        std::cout << test_failures << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Packs the sprite sheets and UI images under res/ into a few large atlas pages plus a manifest
+// that render_load_image uses to resolve each image path to a sub-rect of a page.
+//
+// Usage: atlas_packer <output_dir> <image.png>...
+
+#include "json.hpp"
+#include "path.hpp"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using nlohmann::json;
+
+const int PAGE_SIZE = 1024;
+const int PADDING = 1;
+
+typedef struct PackedImage {
+    std::string path;
+    SDL_Surface* surface;
+    int page;
+    SDL_Rect rect;
+} PackedImage;
+
+typedef struct Shelf {
+    int y;
+    int height;
+    int cursor_x;
+} Shelf;
+
+typedef struct Page {
+    std::vector<Shelf> shelves;
+    int next_shelf_y;
+} Page;
+
+// Shelf packing, images are placed left to right on the first shelf that has room and is tall enough,
+// otherwise a new shelf is opened below the last one
+bool page_insert(Page& page, int width, int height, SDL_Rect& rect) {
+    int padded_width = width + PADDING;
+    int padded_height = height + PADDING;
+
+    for(Shelf& shelf : page.shelves) {
+        if(shelf.height >= padded_height && shelf.cursor_x + padded_width <= PAGE_SIZE) {
+            rect = (SDL_Rect) { .x = shelf.cursor_x, .y = shelf.y, .w = width, .h = height };
+            shelf.cursor_x += padded_width;
+            return true;
+        }
+    }
+
+    if(page.next_shelf_y + padded_height > PAGE_SIZE) {
+        return false;
+    }
+
+    page.shelves.push_back((Shelf) { .y = page.next_shelf_y, .height = padded_height, .cursor_x = padded_width });
+    rect = (SDL_Rect) { .x = 0, .y = page.next_shelf_y, .w = width, .h = height };
+    page.next_shelf_y += padded_height;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        std::cout << "Usage: " << argv[0] << " <output_dir> <image.png>..." << std::endl;
+        return 1;
+    }
+    std::string output_dir = argv[1];
+
+    if(!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        std::cout << "Unable to initialize SDL_image! SDL Error: " << IMG_GetError() << std::endl;
+        return 1;
+    }
+
+    // Load every image
+    std::vector<PackedImage> images;
+    for(int i = 2; i < argc; i++) {
+        SDL_Surface* loaded_surface = IMG_Load(argv[i]);
+        if(loaded_surface == nullptr) {
+            std::cout << "Unable to load image " << argv[i] << "! SDL Error " << IMG_GetError() << std::endl;
+            continue;
+        }
+        if(loaded_surface->w + PADDING > PAGE_SIZE || loaded_surface->h + PADDING > PAGE_SIZE) {
+            std::cout << "Skipping " << argv[i] << ", it is larger than an atlas page" << std::endl;
+            SDL_FreeSurface(loaded_surface);
+            continue;
+        }
+
+        images.push_back((PackedImage) {
+            .path = path_canonicalize(argv[i]),
+            .surface = loaded_surface,
+            .page = -1,
+            .rect = (SDL_Rect) { .x = 0, .y = 0, .w = 0, .h = 0 }
+        });
+    }
+
+    // Tallest first keeps the shelves tight
+    std::sort(images.begin(), images.end(), [](const PackedImage& a, const PackedImage& b) {
+        if(a.surface->h != b.surface->h) {
+            return a.surface->h > b.surface->h;
+        }
+        return a.path < b.path;
+    });
+
+    std::vector<Page> pages;
+    for(PackedImage& image : images) {
+        for(int page_index = 0; page_index < (int)pages.size(); page_index++) {
+            if(page_insert(pages[page_index], image.surface->w, image.surface->h, image.rect)) {
+                image.page = page_index;
+                break;
+            }
+        }
+        if(image.page == -1) {
+            pages.push_back((Page) { .shelves = std::vector<Shelf>(), .next_shelf_y = 0 });
+            page_insert(pages[pages.size() - 1], image.surface->w, image.surface->h, image.rect);
+            image.page = pages.size() - 1;
+        }
+    }
+
+    // Blit the images onto their pages and write them out
+    json manifest;
+    manifest["page_size"] = PAGE_SIZE;
+    manifest["pages"] = json::array();
+    manifest["images"] = json::object();
+
+    bool success = true;
+    for(int page_index = 0; page_index < (int)pages.size(); page_index++) {
+        SDL_Surface* page_surface = SDL_CreateRGBSurfaceWithFormat(0, PAGE_SIZE, PAGE_SIZE, 32, SDL_PIXELFORMAT_RGBA32);
+        if(page_surface == nullptr) {
+            std::cout << "Unable to create atlas page surface! SDL Error " << SDL_GetError() << std::endl;
+            return 1;
+        }
+        SDL_FillRect(page_surface, NULL, 0);
+
+        for(PackedImage& image : images) {
+            if(image.page != page_index) {
+                continue;
+            }
+
+            // Copy the pixels as they are, including alpha, rather than blending them onto the empty page
+            SDL_SetSurfaceBlendMode(image.surface, SDL_BLENDMODE_NONE);
+            SDL_Rect dst_rect = image.rect;
+            SDL_BlitSurface(image.surface, NULL, page_surface, &dst_rect);
+
+            manifest["images"][image.path] = {
+                { "page", page_index },
+                { "rect", { image.rect.x, image.rect.y, image.rect.w, image.rect.h } }
+            };
+        }
+
+        std::string page_path = path_canonicalize(output_dir + "/page" + std::to_string(page_index) + ".png");
+        if(IMG_SavePNG(page_surface, page_path.c_str()) != 0) {
+            std::cout << "Unable to save atlas page " << page_path << "! SDL Error " << IMG_GetError() << std::endl;
+            success = false;
+        }
+        manifest["pages"].push_back(page_path);
+        SDL_FreeSurface(page_surface);
+    }
+
+    for(PackedImage& image : images) {
+        SDL_FreeSurface(image.surface);
+    }
+
+    std::ofstream manifest_file(output_dir + "/manifest.json");
+    manifest_file << manifest.dump(4) << std::endl;
+    manifest_file.close();
+
+    std::cout << "Packed " << images.size() << " images into " << pages.size() << " pages" << std::endl;
+
+    IMG_Quit();
+
+    return success ? 0 : 1;
+}
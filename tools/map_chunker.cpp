@@ -0,0 +1,94 @@
+// Splits a map background into fixed size chunk images plus a chunks.json manifest,
+// which Scene can stream in and out around the camera instead of holding the whole map as one texture.
+//
+// Usage: map_chunker <map.png> <output_dir> [chunk_size]
+
+#include "json.hpp"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using nlohmann::json;
+
+const int DEFAULT_CHUNK_SIZE = 256;
+
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        std::cout << "Usage: " << argv[0] << " <map.png> <output_dir> [chunk_size]" << std::endl;
+        return 1;
+    }
+    std::string map_path = argv[1];
+    std::string output_dir = argv[2];
+    int chunk_size = DEFAULT_CHUNK_SIZE;
+    if(argc >= 4) {
+        // atoi gives 0 for anything that isn't a number, so that's rejected along with sizes that can't be chunked by
+        chunk_size = atoi(argv[3]);
+        if(chunk_size <= 0) {
+            std::cout << "Chunk size must be a positive number of pixels, got " << argv[3] << std::endl;
+            std::cout << "Usage: " << argv[0] << " <map.png> <output_dir> [chunk_size]" << std::endl;
+            return 1;
+        }
+    }
+
+    if(!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG)) {
+        std::cout << "Unable to initialize SDL_image! SDL Error: " << IMG_GetError() << std::endl;
+        return 1;
+    }
+
+    SDL_Surface* map_surface = IMG_Load(map_path.c_str());
+    if(map_surface == nullptr) {
+        std::cout << "Unable to load map " << map_path << "! SDL Error " << IMG_GetError() << std::endl;
+        return 1;
+    }
+    SDL_SetSurfaceBlendMode(map_surface, SDL_BLENDMODE_NONE);
+
+    int columns = (map_surface->w + chunk_size - 1) / chunk_size;
+    int rows = (map_surface->h + chunk_size - 1) / chunk_size;
+
+    bool success = true;
+    for(int row = 0; row < rows; row++) {
+        for(int column = 0; column < columns; column++) {
+            SDL_Rect src_rect = (SDL_Rect) {
+                .x = column * chunk_size,
+                .y = row * chunk_size,
+                .w = std::min(chunk_size, map_surface->w - (column * chunk_size)),
+                .h = std::min(chunk_size, map_surface->h - (row * chunk_size))
+            };
+
+            SDL_Surface* chunk_surface = SDL_CreateRGBSurfaceWithFormat(0, src_rect.w, src_rect.h, 32, SDL_PIXELFORMAT_RGBA32);
+            if(chunk_surface == nullptr) {
+                std::cout << "Unable to create chunk surface! SDL Error " << SDL_GetError() << std::endl;
+                return 1;
+            }
+            SDL_BlitSurface(map_surface, &src_rect, chunk_surface, NULL);
+
+            std::string chunk_path = output_dir + "/" + std::to_string(column) + "_" + std::to_string(row) + ".png";
+            if(IMG_SavePNG(chunk_surface, chunk_path.c_str()) != 0) {
+                std::cout << "Unable to save chunk " << chunk_path << "! SDL Error " << IMG_GetError() << std::endl;
+                success = false;
+            }
+            SDL_FreeSurface(chunk_surface);
+        }
+    }
+
+    json manifest;
+    manifest["chunk_size"] = chunk_size;
+    manifest["map_size"] = { map_surface->w, map_surface->h };
+    manifest["columns"] = columns;
+    manifest["rows"] = rows;
+
+    std::ofstream manifest_file(output_dir + "/chunks.json");
+    manifest_file << manifest.dump(4) << std::endl;
+    manifest_file.close();
+
+    std::cout << "Split " << map_path << " into " << columns << "x" << rows << " chunks of " << chunk_size << "px" << std::endl;
+
+    SDL_FreeSurface(map_surface);
+    IMG_Quit();
+
+    return success ? 0 : 1;
+}